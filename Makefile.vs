@@ -22,7 +22,7 @@ PGOLOG = nanohamicro_prof.txt
 OBJS = mate1ply.obj misc.obj timeman.obj evaluate.obj position.obj \
 	 tt.obj main.obj move.obj \
 	 movegen.obj search.obj uci.obj movepick.obj thread.obj ucioption.obj \
-	 benchmark.obj book.obj \
+	 benchmark.obj book.obj posfile.obj \
 	 shogi.obj mate.obj problem.obj
 
 CC=cl
@@ -18,16 +18,23 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <vector>
 
 #include "position.h"
+#include "posfile.h"
 #include "search.h"
 #include "ucioption.h"
 #if defined(NANOHA)
 #include "movegen.h"
 #include "evaluate.h"
+#include "misc.h"
+#include "rkiss.h"
+#include "thread.h"
+#include "tt.h"
 #endif
 
 using namespace std;
@@ -104,7 +111,11 @@ static const string Defaults[] = {
 
 void benchmark(int argc, char* argv[]) {
 
+#if defined(NANOHA)
+	PositionReader fenList;
+#else
 	vector<string> fenList;
+#endif
 	SearchLimits limits;
 	int64_t totalNodes;
 	int time;
@@ -115,10 +126,16 @@ void benchmark(int argc, char* argv[]) {
 	string valStr  = argc > 4 ? argv[4] : "12";
 	string fenFile = argc > 5 ? argv[5] : "default";
 	string valType = argc > 6 ? argv[6] : "depth";
+#if defined(NANOHA)
+	string evalNuma = argc > 7 ? argv[7] : "off";
+#endif
 
 	Options["Hash"].set_value(ttSize);
 	Options["Threads"].set_value(threads);
 	Options["OwnBook"].set_value("false");
+#if defined(NANOHA)
+	Options["EvalNuma"].set_value(evalNuma == "on" ? "true" : "false");
+#endif
 
 	// Search should be limited by nodes, time or depth ?
 	if (valType == "nodes")
@@ -129,6 +146,19 @@ void benchmark(int argc, char* argv[]) {
 		limits.maxDepth = atoi(valStr.c_str());
 
 	// Do we need to load positions from a given FEN file ?
+#if defined(NANOHA)
+	if (fenFile != "default")
+	{
+		// SFEN eLXgǖʃt@C
+		if (!fenList.open(fenFile))
+		{
+			cerr << "Unable to open file " << fenFile << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	else // Load default positions
+		fenList.open(Defaults);
+#else
 	if (fenFile != "default")
 	{
 		string fen;
@@ -149,20 +179,27 @@ void benchmark(int argc, char* argv[]) {
 	else // Load default positions
 		for (int i = 0; !Defaults[i].empty(); i++)
 			fenList.push_back(Defaults[i]);
+#endif
 
 	// Ok, let's start the benchmark !
 	totalNodes = 0;
 #if defined(NANOHA)
 	int64_t totalTNodes = 0;
+	int64_t totalEvalProbes = 0, totalEvalHits = 0;
+	int64_t totalSplitCopies = 0, totalSplitTicks = 0;
+	int64_t numaNodes[MAX_THREADS] = {0};
 #endif
 	time = get_system_time();
 
-	for (size_t i = 0; i < fenList.size(); i++)
+#if defined(NANOHA)
+	Position pos(Defaults[0], 0);
+	for (size_t i = 0; fenList.next(pos); i++)
 	{
 		Move moves[] = { MOVE_NONE };
-#if defined(NANOHA)
-		Position pos(fenList[i], 0);
 #else
+	for (size_t i = 0; i < fenList.size(); i++)
+	{
+		Move moves[] = { MOVE_NONE };
 		Position pos(fenList[i], false, 0);
 #endif
 		cerr << "\nBench position: " << i + 1 << '/' << fenList.size() << endl;
@@ -184,6 +221,16 @@ void benchmark(int argc, char* argv[]) {
 			totalNodes += pos.nodes_searched();
 #if defined(NANOHA)
 			totalTNodes += pos.tnodes_searched();
+			int64_t probes, hits;
+			eval_hash_stats(&probes, &hits);
+			totalEvalProbes += probes;
+			totalEvalHits += hits;
+			for (int t = 0; t < MAX_THREADS; t++)
+			{
+				numaNodes[Max(Threads[t].numaNode, 0)] += Threads[t].searchedNodes;
+				totalSplitCopies += Threads[t].splitCopies;
+				totalSplitTicks += Threads[t].splitCopyTicks;
+			}
 #endif
 		}
 	}
@@ -198,7 +245,16 @@ void benchmark(int argc, char* argv[]) {
 #else
 		 << "\nTNodes searched : " << totalTNodes
 		 << "\nNodes/second    : " << (int)(totalNodes / (time / 1000.0))
-		 << "\nNodes/s(all)    : " << (int)((totalNodes+totalTNodes) / (time / 1000.0)) << endl;
+		 << "\nNodes/s(all)    : " << (int)((totalNodes+totalTNodes) / (time / 1000.0))
+		 << "\nEval hash       : " << EvalHash.mb_size() << "MB, hits " << totalEvalHits << '/' << totalEvalProbes
+		 << " (" << (totalEvalProbes ? totalEvalHits * 1000 / totalEvalProbes : 0) / 10.0 << "%)"
+		 << "\nSplit copies    : " << totalSplitCopies << ", " << (totalSplitCopies ? totalSplitTicks / totalSplitCopies : 0)
+		 << " ticks each"
+		 << "\nEvalNuma        : " << evalNuma << ", " << numa_node_count() << " node(s)" << endl;
+
+	// Per node speed, the threads only stay on one node when EvalNuma is on
+	for (int n = 0; evalNuma == "on" && n < numa_node_count(); n++)
+		cerr << "Nodes/s node " << n << "  : " << (int)(numaNodes[n] / (time / 1000.0)) << endl;
 #endif
 }
 
@@ -355,7 +411,7 @@ void bench_mate(int argc, char* argv[]) {
 
 void bench_genmove(int argc, char* argv[]) {
 
-	vector<string> sfenList;
+	PositionReader sfenList;
 	int time;
 
 	// ftHglݒ
@@ -366,31 +422,15 @@ void bench_genmove(int argc, char* argv[]) {
 
 	if (fenFile != "default")
 	{
-		string fen;
-		ifstream f(fenFile.c_str());
-
-		if (!f.is_open())
+		if (!sfenList.open(fenFile))
 		{
 			cerr << "Unable to open file " << fenFile << endl;
 			exit(EXIT_FAILURE);
 		}
-
-		while (getline(f, fen)) {
-			if (!fen.empty()) {
-				if (fen.compare(0, 5, "sfen ") == 0) {
-					fen.erase(0, 5);
-				}
-				sfenList.push_back(fen);
-			}
-		}
-
-		f.close();
 		cerr << "SFEN file is" << fenFile << "." << endl;
 	}
 	else {
-		for (int i = 0; !GenMoves[i].empty(); i++) {
-			sfenList.push_back(GenMoves[i]);
-		}
+		sfenList.open(GenMoves);
 		cerr << "SFENs is default." << endl;
 	}
 
@@ -404,9 +444,9 @@ void bench_genmove(int argc, char* argv[]) {
 	int loops = 500*1000; // 500k
 #endif
 	int j;
-	for (size_t i = 0; i < sfenList.size(); i++)
+	Position pos(GenMoves[0], 0);
+	for (size_t i = 0; sfenList.next(pos); i++)
 	{
-		Position pos(sfenList[i], 0);
 #if defined(_DEBUG)
 		int failState;
 		assert(pos.is_ok(&failState));
@@ -445,6 +485,20 @@ void bench_genmove(int argc, char* argv[]) {
 		rap_time = get_system_time() - rap_time;
 		cerr << "  gen_check(" << mlist - ss << "): " << rap_time << "(ms), " << conv_per_s(loops, rap_time) << "times/s" << endl;
 		if (bDisplay) disp_moves(ss, mlist - ss);
+
+		// @ׂĎwĖ߂
+		const int n = int(generate<MV_LEGAL>(pos, ss) - ss);
+		const int doLoops = loops / 10;
+		StateInfo st;
+		rap_time = get_system_time();
+		for (j = 0; j < doLoops; j++) {
+			for (int k = 0; k < n; k++) {
+				pos.do_move(ss[k].move, st);
+				pos.undo_move(ss[k].move);
+			}
+		}
+		rap_time = get_system_time() - rap_time;
+		cerr << "  do/undo(" << n << "): " << rap_time << "(ms), " << conv_per_s(double(doLoops) * n, rap_time) << "moves/s" << endl;
 	}
 
 	time = get_system_time() - time;
@@ -453,9 +507,82 @@ void bench_genmove(int argc, char* argv[]) {
 		 << "\nTotal time (ms) : " << time << endl;
 }
 
+// ̍XṼRXg𑪂B
+// @AEы(pn)𓮂/łEȊOɕ do_move()/undo_move() JԂ
+void bench_effect(int argc, char* argv[]) {
+
+	PositionReader sfenList;
+	string fenFile = argc > 2 ? argv[2] : "default";
+
+	cerr << "Benchmark type: effect update." << endl;
+
+	if (fenFile != "default")
+	{
+		if (!sfenList.open(fenFile))
+		{
+			cerr << "Unable to open file " << fenFile << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	else {
+		sfenList.open(Defaults);
+	}
+
+#if defined(NDEBUG)
+	const int loops = 100*1000;
+#else
+	const int loops = 5*1000;
+#endif
+	enum { CAPTURE, SLIDER, OTHER, CLASS_NB };
+	static const char *className[CLASS_NB] = { "capture", "slider ", "other  " };
+	double moves[CLASS_NB] = { 0 };
+	int times[CLASS_NB] = { 0 };
+
+	MoveStack ss[MAX_MOVES];
+	Move mlist[CLASS_NB][MAX_MOVES];
+	StateInfo st;
+	int time = get_system_time();
+	Position pos(Defaults[0], 0);
+	size_t i;
+	for (i = 0; sfenList.next(pos); i++)
+	{
+		int n[CLASS_NB] = { 0 };
+		const MoveStack *last = generate<MV_LEGAL>(pos, ss);
+		for (const MoveStack *p = ss; p < last; p++) {
+			const Move m = p->move;
+			const PieceType pt = move_ptype(m);
+			const int c = (move_captured(m) != EMP) ? CAPTURE
+			            : (pt == KY || pt == KA || pt == HI || pt == UM || pt == RY) ? SLIDER
+			            : OTHER;
+			mlist[c][n[c]++] = m;
+		}
+		for (int c = 0; c < CLASS_NB; c++) {
+			const int rap_time = get_system_time();
+			for (int j = 0; j < loops; j++) {
+				for (int k = 0; k < n[c]; k++) {
+					pos.do_move(mlist[c][k], st);
+					pos.undo_move(mlist[c][k]);
+				}
+			}
+			times[c] += get_system_time() - rap_time;
+			moves[c] += double(loops) * n[c];
+		}
+	}
+
+	time = get_system_time() - time;
+
+	cerr << "\n==============================="
+	     << "\nPositions       : " << i
+	     << "\nTotal time (ms) : " << time << endl;
+	for (int c = 0; c < CLASS_NB; c++) {
+		cerr << "  " << className[c] << " do/undo: " << int64_t(moves[c]) << " moves, " << times[c] << "(ms), "
+		     << conv_per_s(moves[c], times[c]) << "moves/s" << endl;
+	}
+}
+
 void bench_eval(int argc, char* argv[]) {
 
-	vector<string> sfenList;
+	PositionReader sfenList;
 	int time;
 
 	// ftHglݒ
@@ -466,31 +593,15 @@ void bench_eval(int argc, char* argv[]) {
 
 	if (fenFile != "default")
 	{
-		string fen;
-		ifstream f(fenFile.c_str());
-
-		if (!f.is_open())
+		if (!sfenList.open(fenFile))
 		{
 			cerr << "Unable to open file " << fenFile << endl;
 			exit(EXIT_FAILURE);
 		}
-
-		while (getline(f, fen)) {
-			if (!fen.empty()) {
-				if (fen.compare(0, 5, "sfen ") == 0) {
-					fen.erase(0, 5);
-				}
-				sfenList.push_back(fen);
-			}
-		}
-
-		f.close();
 		cerr << "SFEN file is" << fenFile << "." << endl;
 	}
 	else {
-		for (int i = 0; !EvalPos[i].empty(); i++) {
-			sfenList.push_back(EvalPos[i]);
-		}
+		sfenList.open(EvalPos);
 	}
 
 	time = get_system_time();
@@ -503,27 +614,507 @@ void bench_eval(int argc, char* argv[]) {
 	int j;
 	volatile Value v = VALUE_ZERO;
 	Value m = VALUE_ZERO;
-	for (size_t i = 0; i < sfenList.size(); i++)
+	const EvalKernel kernel = get_eval_kernel();
+	vector<int> values;
+	cerr << "Eval kernel: " << eval_kernel_name(kernel) << endl;
+	cerr << "Eval table : " << eval_image_info(get_eval_image()) << endl;
+	Position pos(EvalPos[0], 0);
+	for (size_t i = 0; sfenList.next(pos); i++)
 	{
-		Position pos(sfenList[i], 0);
 #if defined(_DEBUG)
 		int failState;
 		assert(pos.is_ok(&failState));
 #endif
 
 		cerr << "\nBench position: " << i + 1 << '/' << sfenList.size() << endl;
-		int rap_time = get_system_time();
-		for (j = 0; j < loops; j++) {
-			v = evaluate(pos, m);
+		// SvZ KPP ̎Ƃɑ
+		int scalar_time = 0;
+		Value scalar_v = VALUE_ZERO;
+		for (int k = 0; k < EVAL_KERNEL_NB; k++) {
+			if (!set_eval_kernel(EvalKernel(k))) continue;
+			int rap_time = get_system_time();
+			for (j = 0; j < loops; j++) {
+				pos.calc_eval_full();	// SvZ
+				v = evaluate(pos, m);
+			}
+			rap_time = get_system_time() - rap_time;
+			cerr << "  evaluate()[" << eval_kernel_name(EvalKernel(k)) << "]:m=" << pos.get_material() << ", v= " << int(v) << ", margin=" << int(m) << ", time= " << rap_time << "(ms), " << conv_per_s(loops, rap_time) << " evaluate/s";
+			if (k == EVAL_KERNEL_SCALAR) {
+				scalar_time = rap_time;
+				scalar_v = v;
+			} else {
+				const int ratio = scalar_time * 100 / (rap_time > 0 ? rap_time : 1);	// scalar (%)
+				cerr << ", x" << ratio / 100 << '.' << (ratio % 100 < 10 ? "0" : "") << ratio % 100
+				     << (v == scalar_v ? "" : " (MISMATCH)");
+			}
+			cerr << endl;
 		}
-		rap_time = get_system_time() - rap_time;
+		set_eval_kernel(kernel);
+		values.push_back(v);
 		if (bDisplay) pos.print_csa();
-		cerr << "  evaluate():m=" << pos.get_material() << ", v= " << int(v) << ", margin=" << int(m) << ", time= " << rap_time << "(ms), " << conv_per_s(loops, rap_time) << " evaluate/s" << endl;
+
+		// ʃXg̍쐬A\̂̂ƔՖʂ𑖍̂ƂŔׂ
+		{
+			int list0[NLIST], list1[NLIST], score = 0;
+			int n = 0, n_scan = 0;
+			vector<pair<int, int> > fe, fe_scan;
+			int list_time = get_system_time();
+			for (j = 0; j < loops; j++) n = pos.make_list(&score, list0, list1);
+			list_time = get_system_time() - list_time;
+			for (j = 0; j < n; j++) fe.push_back(make_pair(list0[j], list1[j]));
+			int scan_time = get_system_time();
+			for (j = 0; j < loops; j++) n_scan = pos.make_list_scan(&score, list0, list1);
+			scan_time = get_system_time() - scan_time;
+			for (j = 0; j < n_scan; j++) fe_scan.push_back(make_pair(list0[j], list1[j]));
+			sort(fe.begin(), fe.end());
+			sort(fe_scan.begin(), fe_scan.end());
+			const int ratio = scan_time * 100 / (list_time > 0 ? list_time : 1);
+			cerr << "  make_list(): n= " << n << ", table= " << list_time << "(ms), scan= " << scan_time
+			     << "(ms), x" << ratio / 100 << '.' << (ratio % 100 < 10 ? "0" : "") << ratio % 100
+			     << (fe == fe_scan ? "" : " (MISMATCH)") << endl;
+		}
+
+		// @1肸wāAvZƑSvZ̑xׂ
+		MoveStack mstack[MAX_MOVES];
+		const int nmove = int(generate<MV_LEGAL>(pos, mstack) - mstack);
+		if (nmove == 0) continue;
+
+		StateInfo st;
+		const int rounds = loops / 10 / nmove + 1;
+		int k, mismatch = 0;
+		int diff_time = get_system_time();
+		for (j = 0; j < rounds; j++) {
+			for (k = 0; k < nmove; k++) {
+				pos.do_move(mstack[k].move, st);
+				v = evaluate(pos, m);
+				pos.undo_move(mstack[k].move);
+			}
+		}
+		diff_time = get_system_time() - diff_time;
+		int full_time = get_system_time();
+		for (j = 0; j < rounds; j++) {
+			for (k = 0; k < nmove; k++) {
+				pos.do_move(mstack[k].move, st);
+				pos.calc_eval_full();
+				v = evaluate(pos, m);
+				pos.undo_move(mstack[k].move);
+			}
+		}
+		full_time = get_system_time() - full_time;
+		for (k = 0; k < nmove; k++) {
+			pos.do_move(mstack[k].move, st);
+			const Value vd = evaluate(pos, m);
+			pos.calc_eval_full();
+			if (evaluate(pos, m) != vd) mismatch++;
+			pos.undo_move(mstack[k].move);
+		}
+		cerr << "  do_move()+evaluate(): " << nmove << " moves x " << rounds
+		     << ", diff= " << diff_time << "(ms), full= " << full_time << "(ms), mismatch= " << mismatch << endl;
 	}
 
 	time = get_system_time() - time;
 
 	cerr << "\n==============================="
 		 << "\nTotal time (ms) : " << time << endl;
+
+	// EvalPos  2Ԗڂ3Ԗڂ͍E]A4Ԗڂ5Ԗڂ͂ꂼ̎Ԃς
+	if (fenFile == "default") {
+		const bool ok = values[1] == values[2] && values[3] == -values[1] && values[4] == -values[2];
+		cerr << "Mirror check    : " << values[1] << ' ' << values[2] << ' ' << values[3] << ' ' << values[4]
+		     << (ok ? " ok" : " (MISMATCH)") << endl;
+	}
+}
+
+// 2̕]xNg(int16  int8 Ȃ)ŁA]l̍Ƒxׂ
+void bench_evalcmp(int argc, char* argv[]) {
+
+	// ftHglݒ
+	string files[2];
+	files[0] = argc > 2 ? argv[2] : "fv3.bin";
+	files[1] = argc > 3 ? argv[3] : "fv3map.bin";
+	int depth = argc > 4 ? atoi(argv[4]) : 7;
+
+	cerr << "Benchmark type: compare evaluation tables." << endl;
+
+	EvalImage *img[2];
+	for (int n = 0; n < 2; n++) {
+		img[n] = load_eval_image(files[n].c_str());
+		if (img[n] == NULL) {
+			cerr << "Unable to load " << files[n] << endl;
+			exit(EXIT_FAILURE);
+		}
+		cerr << "  " << char('A' + n) << ": " << files[n] << " (" << eval_image_info(img[n]) << ")" << endl;
+	}
+	EvalImage *saved = get_eval_image();
+
+	vector<string> sfenList;
+	for (int i = 0; !EvalPos[i].empty(); i++) sfenList.push_back(EvalPos[i]);
+	for (int i = 0; !Defaults[i].empty(); i++) sfenList.push_back(Defaults[i]);
+
+	// eǖʂƂ̎qǖʂ̕]lSvZŋ߂
+#if defined(NDEBUG)
+	const int loops = 100*1000;
+#else
+	const int loops =   5*1000;
+#endif
+	vector<int> values[2];
+	int full_time[2];
+	Value m;
+	for (int n = 0; n < 2; n++) {
+		set_eval_image(img[n]);
+		full_time[n] = 0;
+		for (size_t i = 0; i < sfenList.size(); i++) {
+			Position pos(sfenList[i], 0);
+			MoveStack mstack[MAX_MOVES];
+			const int nmove = int(generate<MV_LEGAL>(pos, mstack) - mstack);
+			StateInfo st;
+			pos.calc_eval_full();
+			values[n].push_back(evaluate(pos, m));
+			for (int k = 0; k < nmove; k++) {
+				pos.do_move(mstack[k].move, st);
+				pos.calc_eval_full();
+				values[n].push_back(evaluate(pos, m));
+				pos.undo_move(mstack[k].move);
+			}
+
+			volatile Value v;
+			int rap_time = get_system_time();
+			for (int j = 0; j < loops; j++) {
+				pos.calc_eval_full();
+				v = evaluate(pos, m);
+			}
+			full_time[n] += get_system_time() - rap_time;
+			(void)v;
+		}
+	}
+	int64_t total_diff = 0;
+	int max_diff = 0, same = 0;
+	for (size_t i = 0; i < values[0].size(); i++) {
+		const int d = abs(values[0][i] - values[1][i]);
+		total_diff += d;
+		if (d > max_diff) max_diff = d;
+		if (d == 0) same++;
+	}
+
+	// [ŒT nps ׂ
+	SearchLimits limits;
+	limits.maxDepth = depth;
+	Options["OwnBook"].set_value("false");
+	int64_t nodes[2];
+	int search_time[2];
+	for (int n = 0; n < 2; n++) {
+		set_eval_image(img[n]);
+		Options["Clear Hash"].set_value("true");
+		nodes[n] = 0;
+		search_time[n] = get_system_time();
+		for (int i = 0; !Defaults[i].empty(); i++) {
+			Move moves[] = { MOVE_NONE };
+			Position pos(Defaults[i], 0);
+			if (!think(pos, limits, moves)) break;
+			nodes[n] += pos.nodes_searched() + pos.tnodes_searched();
+		}
+		search_time[n] = get_system_time() - search_time[n];
+		if (search_time[n] == 0) search_time[n] = 1;
+	}
+	set_eval_image(saved);
+	release_eval_image(img[0]);
+	release_eval_image(img[1]);
+
+	const double nps[2] = { nodes[0] * 1000.0 / search_time[0], nodes[1] * 1000.0 / search_time[1] };
+	const double evals = double(loops) * sfenList.size();
+	cerr << "\n==============================="
+	     << "\nPositions       : " << values[0].size()
+	     << "\nEval diff (A-B) : avg " << double(total_diff) / values[0].size() << ", max " << max_diff
+	     << ", same " << same
+	     << "\nFull eval A     : " << full_time[0] << "(ms), " << conv_per_s(evals, full_time[0]) << " evaluate/s"
+	     << "\nFull eval B     : " << full_time[1] << "(ms), " << conv_per_s(evals, full_time[1]) << " evaluate/s"
+	     << "\nSearch A        : " << nodes[0] << " nodes, " << search_time[0] << "(ms), " << int(nps[0]) << " nps"
+	     << "\nSearch B        : " << nodes[1] << " nodes, " << search_time[1] << "(ms), " << int(nps[1]) << " nps"
+	     << "\nnps B/A         : " << nps[1] / nps[0] << endl;
+}
+
+namespace {
+	// ǖʂ̓ʂƁA1ǖʂ evaluate() Ƃ̕]l
+	void add_eval_features(Position &pos, vector<EvalFeatures> &feats, vector<Value> &expect)
+	{
+		Value m;
+		pos.calc_eval_full();
+		expect.push_back(evaluate(pos, m));
+		feats.push_back(EvalFeatures());
+		pos.make_eval_features(feats.back());
+	}
+}
+
+// evaluate_batch() ̐ǂ݂̌ʂ𑪂
+void bench_evalbatch(int argc, char* argv[]) {
+
+	vector<string> sfenList;
+
+	// ftHglݒ
+	string fenFile = argc > 2 ? argv[2] : "default";
+	const size_t maxPositions = 100*1000;
+
+	cerr << "Benchmark type: evaluate_batch." << endl;
+
+	if (fenFile != "default")
+	{
+		string fen;
+		ifstream f(fenFile.c_str());
+
+		if (!f.is_open())
+		{
+			cerr << "Unable to open file " << fenFile << endl;
+			exit(EXIT_FAILURE);
+		}
+
+		while (getline(f, fen)) {
+			if (!fen.empty()) {
+				if (fen.compare(0, 5, "sfen ") == 0) {
+					fen.erase(0, 5);
+				}
+				sfenList.push_back(fen);
+			}
+		}
+
+		f.close();
+		cerr << "SFEN file is" << fenFile << "." << endl;
+	}
+	else {
+		for (int i = 0; !EvalPos[i].empty(); i++) sfenList.push_back(EvalPos[i]);
+		for (int i = 0; !Defaults[i].empty(); i++) sfenList.push_back(Defaults[i]);
+	}
+
+	// ̋ǖʂł́A2܂ł̋ǖʂg
+	vector<EvalFeatures> feats;
+	vector<Value> expect;
+	for (size_t i = 0; i < sfenList.size() && feats.size() < maxPositions; i++)
+	{
+		Position pos(sfenList[i], 0);
+		add_eval_features(pos, feats, expect);
+		if (fenFile != "default") continue;
+
+		// ʂ̈ʒu΂Ȃ悤ɁA̋ǖʂƂɓ܂
+		const size_t limit = feats.size() + maxPositions / sfenList.size();
+		MoveStack ms1[MAX_MOVES], ms2[MAX_MOVES];
+		StateInfo st1, st2;
+		const int n1 = int(generate<MV_LEGAL>(pos, ms1) - ms1);
+		for (int j = 0; j < n1 && feats.size() < limit; j++) {
+			pos.do_move(ms1[j].move, st1);
+			add_eval_features(pos, feats, expect);
+			const int n2 = int(generate<MV_LEGAL>(pos, ms2) - ms2);
+			for (int k = 0; k < n2 && feats.size() < limit; k++) {
+				pos.do_move(ms2[k].move, st2);
+				add_eval_features(pos, feats, expect);
+				pos.undo_move(ms2[k].move);
+			}
+			pos.undo_move(ms1[j].move);
+		}
+	}
+	// ͂wKœǂދǖʂ̕тɋ߂Â邽߁AԂ
+	RKISS rk;
+	for (size_t i = feats.size(); i > 1; i--) {
+		const size_t j = size_t(rk.rand<uint32_t>() % i);
+		swap(feats[i - 1], feats[j]);
+		swap(expect[i - 1], expect[j]);
+	}
+
+	const int n = int(feats.size());
+	const int rounds = 1000*1000 / n + 1;
+	vector<Value> values(n);
+	cerr << "Positions: " << n << " x " << rounds << endl;
+	cerr << "Eval table: " << eval_image_info(get_eval_image()) << endl;
+
+	const int aheads[] = { 0, 1, 2, 4, 8, 15 };
+	int base_time = 0;
+	for (size_t a = 0; a < sizeof(aheads) / sizeof(aheads[0]); a++) {
+		int rap_time = get_system_time();
+		for (int r = 0; r < rounds; r++) {
+			evaluate_batch(&feats[0], n, &values[0], aheads[a]);
+		}
+		rap_time = get_system_time() - rap_time;
+		int mismatch = 0;
+		for (int i = 0; i < n; i++) {
+			if (values[i] != expect[i]) mismatch++;
+		}
+		if (a == 0) base_time = rap_time;
+		const int ratio = base_time * 100 / (rap_time > 0 ? rap_time : 1);
+		cerr << "  ahead=" << aheads[a] << (aheads[a] == EVAL_BATCH_AHEAD ? "(default)" : "")
+		     << ": " << rap_time << "(ms), " << conv_per_s(double(n) * rounds, rap_time) << " evaluate/s"
+		     << ", x" << ratio / 100 << '.' << (ratio % 100 < 10 ? "0" : "") << ratio % 100
+		     << ", mismatch= " << mismatch << endl;
+	}
+}
+
+// ]̑SvZ𕔕(make_list, בւ, KK+KKP, KPP)ƂɑB
+// ǖʂ CHUNK ǂ݁AƂɂ܂Ƃ߂ĎsĂ̊Ԃ̃JE^̑𑫂B
+// ʂ̓^u؂ŏo̓t@C(͕Wo)ɏBgȂJE^ "-"
+// bench evalprof [SFEN t@C] [o̓t@C = Wo]
+void bench_evalprof(int argc, char* argv[]) {
+
+	if (argc < 3)
+	{
+		cerr << "Usage: bench evalprof [sfen file] [output file = stdout]" << endl;
+		return;
+	}
+	ifstream in(argv[2]);
+	if (!in.is_open())
+	{
+		cerr << "Unable to open file " << argv[2] << endl;
+		exit(EXIT_FAILURE);
+	}
+	ofstream fout;
+	if (argc > 3)
+	{
+		fout.open(argv[3]);
+		if (!fout.is_open())
+		{
+			cerr << "Unable to open file " << argv[3] << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	ostream &out = (argc > 3) ? static_cast<ostream &>(fout) : cout;
+
+	const PerfCounters pc;
+	const int NB = PerfCounters::EVENT_NB;
+	cerr << "Benchmark type: evaluate profile." << endl;
+	cerr << "Eval kernel: " << eval_kernel_name(get_eval_kernel()) << endl;
+	cerr << "Eval table : " << eval_image_info(get_eval_image()) << endl;
+	cerr << "Counters   :";
+	for (int c = 0; c < NB; c++) {
+		cerr << ' ' << PerfCounters::name(PerfCounters::Event(c)) << (pc.available(PerfCounters::Event(c)) ? "" : "(n/a)");
+	}
+	cerr << endl;
+
+	const size_t CHUNK = 256;
+	uint64_t ticks[EVAL_PART_NB] = { 0 };
+	uint64_t count[EVAL_PART_NB][PerfCounters::EVENT_NB] = { { 0 } };
+	PerfCounters::Sample before, after;
+	vector<Position *> pos;
+	vector<Value> values, expect;
+	string fen;
+	int64_t total = 0, mismatch = 0;
+	int time = get_system_time();
+	bool eof = false;
+	while (!eof)
+	{
+		for (size_t i = 0; i < pos.size(); i++) delete pos[i];
+		pos.clear();
+		expect.clear();
+		while (pos.size() < CHUNK && !(eof = !getline(in, fen))) {
+			if (fen.empty()) continue;
+			if (fen.compare(0, 5, "sfen ") == 0) fen.erase(0, 5);
+			Value m;
+			pos.push_back(new Position(fen, 0));
+			pos.back()->calc_eval_full();
+			expect.push_back(evaluate(*pos.back(), m));
+		}
+		if (pos.empty()) break;
+		const int n = int(pos.size());
+		values.resize(n);
+		for (int p = 0; p < EVAL_PART_NB; p++) {
+			pc.read(before);
+			const uint64_t t = cpu_ticks();
+			eval_profile_part(EvalPart(p), &pos[0], n, &values[0]);
+			ticks[p] += cpu_ticks() - t;
+			pc.read(after);
+			for (int c = 0; c < NB; c++) count[p][c] += PerfCounters::delta(before, after, PerfCounters::Event(c));
+		}
+		for (int i = 0; i < n; i++) {
+			if (values[i] != expect[i]) mismatch++;
+		}
+		total += n;
+	}
+	time = get_system_time() - time;
+
+	out << "part\tpositions\tticks";
+	for (int c = 0; c < NB; c++) out << '\t' << PerfCounters::name(PerfCounters::Event(c));
+	out << '\n';
+	for (int p = 0; p <= EVAL_PART_NB; p++) {
+		uint64_t tk = 0, sum[PerfCounters::EVENT_NB] = { 0 };
+		for (int q = 0; q < EVAL_PART_NB; q++) {
+			if (q != p && p != EVAL_PART_NB) continue;
+			tk += ticks[q];
+			for (int c = 0; c < NB; c++) sum[c] += count[q][c];
+		}
+		out << (p < EVAL_PART_NB ? eval_part_name(EvalPart(p)) : "total") << '\t' << total << '\t' << tk;
+		for (int c = 0; c < NB; c++) {
+			if (pc.available(PerfCounters::Event(c))) out << '\t' << sum[c];
+			else out << "\t-";
+		}
+		out << '\n';
+	}
+	out.flush();
+
+	cerr << total << " positions, " << time << "(ms), mismatch= " << mismatch << endl;
+	for (int p = 0; p < EVAL_PART_NB && total > 0; p++) {
+		cerr << "  " << setw(10) << left << eval_part_name(EvalPart(p)) << right
+		     << ": " << setw(8) << ticks[p] / total << " ticks/position";
+		if (pc.available(PerfCounters::CYCLES))
+			cerr << ", " << setw(8) << count[p][PerfCounters::CYCLES] / total << " cycles";
+		if (pc.available(PerfCounters::L1D_MISSES))
+			cerr << ", " << double(count[p][PerfCounters::L1D_MISSES]) / total << " L1D misses";
+		if (pc.available(PerfCounters::DTLB_MISSES))
+			cerr << ", " << double(count[p][PerfCounters::DTLB_MISSES]) / total << " DTLB misses";
+		cerr << endl;
+	}
+	for (size_t i = 0; i < pos.size(); i++) delete pos[i];
+}
+
+// SFEN ̃t@CǂŁA1sƂ ]l(ԑ猩)  SFEN o
+// evalfile [SFEN t@C] [o̓t@C = Wo]
+void eval_file(int argc, char* argv[]) {
+
+	if (argc < 2)
+	{
+		cerr << "Usage: evalfile [sfen file] [output file = stdout]" << endl;
+		return;
+	}
+	ifstream in(argv[1]);
+	if (!in.is_open())
+	{
+		cerr << "Unable to open file " << argv[1] << endl;
+		exit(EXIT_FAILURE);
+	}
+	ofstream fout;
+	if (argc > 2)
+	{
+		fout.open(argv[2]);
+		if (!fout.is_open())
+		{
+			cerr << "Unable to open file " << argv[2] << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	ostream &out = (argc > 2) ? static_cast<ostream &>(fout) : cout;
+
+	const size_t CHUNK = 4096;
+	vector<string> sfens;
+	vector<EvalFeatures> feats;
+	vector<Value> values;
+	string fen;
+	int64_t total = 0;
+	int time = get_system_time();
+	bool eof = false;
+	while (!eof)
+	{
+		sfens.clear();
+		feats.clear();
+		while (sfens.size() < CHUNK && !(eof = !getline(in, fen))) {
+			if (fen.empty()) continue;
+			if (fen.compare(0, 5, "sfen ") == 0) fen.erase(0, 5);
+			Position pos(fen, 0);
+			sfens.push_back(fen);
+			feats.push_back(EvalFeatures());
+			pos.make_eval_features(feats.back());
+		}
+		if (sfens.empty()) break;
+		values.resize(sfens.size());
+		evaluate_batch(&feats[0], int(feats.size()), &values[0]);
+		for (size_t i = 0; i < sfens.size(); i++) out << int(values[i]) << '\t' << sfens[i] << '\n';
+		total += sfens.size();
+	}
+	out.flush();
+	time = get_system_time() - time;
+	cerr << total << " positions, " << time << "(ms)" << endl;
 }
 #endif
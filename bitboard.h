@@ -0,0 +1,142 @@
+/*
+  NanohaMini, a USI shogi(japanese-chess) playing engine derived from Stockfish 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad (Stockfish author)
+  Copyright (C) 2014 Kazuyuki Kawabata
+
+  NanohaMini is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  NanohaMini is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(BITBOARD_H_INCLUDED)
+#define BITBOARD_H_INCLUDED
+
+#include "types.h"
+
+#if defined(NANOHA)
+
+// Տ81}X̃rbg{[h
+//   fEir̃}X(z = f*0x10 + r) (f-1)*9 + (r-1) Ԗڂ̃rbg.
+//   p[0] 1`7(63rbg)Ap[1] 8`9(18rbg).
+//   ؂Ƃ9rbgAArbg̏ z ̏(0x11, 0x12, ..., 0x99)ƈv.
+struct Bitboard {
+	uint64_t p[2];
+
+	Bitboard() {}
+	Bitboard(const uint64_t p0, const uint64_t p1) {p[0] = p0; p[1] = p1;}
+
+	static int index(const int z) {return (z >> 4) * 9 + (z & 0x0F) - 10;}
+	static int word(const int i) {return i >= 63;}
+	static uint64_t bit(const int i) {return 1ULL << (i - 63 * word(i));}
+
+	bool test(const int z) const {const int i = index(z); return (p[word(i)] & bit(i)) != 0;}
+	void set(const int z)    {const int i = index(z); p[word(i)] |=  bit(i);}
+	void clr(const int z)    {const int i = index(z); p[word(i)] &= ~bit(i);}
+	void toggle(const int z) {const int i = index(z); p[word(i)] ^=  bit(i);}
+
+	bool any() const {return (p[0] | p[1]) != 0;}
+	int count() const;
+	int pop();		// ԏrbgÄʒu(z)Ԃ. łȂ.
+
+	Bitboard& operator&=(const Bitboard& b) {p[0] &= b.p[0]; p[1] &= b.p[1]; return *this;}
+	Bitboard& operator|=(const Bitboard& b) {p[0] |= b.p[0]; p[1] |= b.p[1]; return *this;}
+	Bitboard& operator^=(const Bitboard& b) {p[0] ^= b.p[0]; p[1] ^= b.p[1]; return *this;}
+	Bitboard operator&(const Bitboard& b) const {return Bitboard(p[0] & b.p[0], p[1] & b.p[1]);}
+	Bitboard operator|(const Bitboard& b) const {return Bitboard(p[0] | b.p[0], p[1] | b.p[1]);}
+	Bitboard operator^(const Bitboard& b) const {return Bitboard(p[0] ^ b.p[0], p[1] ^ b.p[1]);}
+	Bitboard operator~() const {return Bitboard(~p[0] & 0x7FFFFFFFFFFFFFFFULL, ~p[1] & 0x3FFFFULL);}
+	bool operator==(const Bitboard& b) const {return p[0] == b.p[0] && p[1] == b.p[1];}
+	bool operator!=(const Bitboard& b) const {return !(*this == b);}
+};
+
+inline int PopCnt64(uint64_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(v);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	return int(__popcnt64(v));
+#else
+	int n = 0;
+	while (v) {v &= v-1; n++;}
+	return n;
+#endif
+}
+
+inline int Bsf64(const uint64_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long i;
+	_BitScanForward64(&i, v);
+	return int(i);
+#else
+	int i = 0;
+	while (((v >> i) & 1) == 0) i++;
+	return i;
+#endif
+}
+
+inline int Bitboard::count() const
+{
+	return PopCnt64(p[0]) + PopCnt64(p[1]);
+}
+
+inline int Bitboard::pop()
+{
+	int i;
+	if (p[0]) {
+		i = Bsf64(p[0]);
+		p[0] &= p[0] - 1;
+	} else {
+		i = Bsf64(p[1]) + 63;
+		p[1] &= p[1] - 1;
+	}
+	return ((i / 9 + 1) << 4) + i % 9 + 1;
+}
+
+inline Bitboard EmptyBB() {return Bitboard(0, 0);}
+
+// f(1`9)̃}X
+inline Bitboard FileBB(const int f)
+{
+	return (f <= 7) ? Bitboard(0x1FFULL << (9 * (f - 1)), 0) : Bitboard(0, 0x1FFULL << (9 * (f - 8)));
+}
+
+// loi`hii(1`9)̃}X
+inline Bitboard RankRangeBB(const int lo, const int hi)
+{
+	const uint64_t m = (1ULL << hi) - (1ULL << (lo - 1));
+	return Bitboard(m * 0x0040201008040201ULL, m * 0x201ULL);
+}
+
+// ؂1łrbg΁A̋؂9}XׂėĂ
+inline Bitboard FileFillBB(const Bitboard& b)
+{
+	const uint64_t L0 = 0x00FFULL * 0x0040201008040201ULL, H0 = 0x0100ULL * 0x0040201008040201ULL;
+	const uint64_t L1 = 0x00FFULL * 0x201ULL,              H1 = 0x0100ULL * 0x201ULL;
+	// e؂̉8rbgɉ΍ŏʃrbgɌJオ(ׂ̋؂ɂ͈Ȃ)
+	const uint64_t t0 = (((b.p[0] & L0) + L0) | b.p[0]) & H0;
+	const uint64_t t1 = (((b.p[1] & L1) + L1) | b.p[1]) & H1;
+	return Bitboard(t0 | (t0 - (t0 >> 8)), t1 | (t1 - (t1 >> 8)));
+}
+
+// us 猩Gw(Oiڂ܂)
+inline Bitboard EnemyCampBB(const Color us)
+{
+	return (us == BLACK) ? RankRangeBB(1, 3) : RankRangeBB(7, 9);
+}
+
+#endif // defined(NANOHA)
+
+#endif // !defined(BITBOARD_H_INCLUDED)
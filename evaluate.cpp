@@ -18,11 +18,49 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+// 32bit ł fseeko()  2GB 𒴂ʒuɈڂ悤
+#if !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#if defined(_MSC_VER) || defined(_WIN32)
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
+// KPP ̑SvZ SIMD łg(ǂg͎s CPU Č߂)
+#if defined(_MSC_VER) || (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
+#define USE_EVAL_SIMD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41	__attribute__((target("sse4.1")))
+#define TARGET_AVX2		__attribute__((target("avx2")))
+#endif
+#define EVAL_PREFETCH(p)	_mm_prefetch(reinterpret_cast<const char *>(p), _MM_HINT_T0)
+#else
+#define EVAL_PREFETCH(p)	((void)(p))
+#endif
+
+#include "misc.h"
 #include "position.h"
 #include "evaluate.h"
+#include "thread.h"
+#include "tt.h"
 
 // ]֐֘A`
 #if defined(EVAL_MICRO)
@@ -30,11 +68,13 @@
 #elif defined(EVAL_OLD)
 #include "param_old.h"
 #define FV_BIN "fv_mini.bin"
+#define FV3_BIN "fv3.bin"			// Bonanza `ϊ]xNg
+#define FV3_MAP "fv3map.bin"		// fv3.bin  mmap pɕϊ(fvconv ō)
 #else
 #include "param_new.h"
 #define FV_BIN "fv_mini2.bin"
 #endif
-#define NLIST	52
+#define EVAL_DIFF_PLY	3		// vZőkő萔
 
 #define FV_SCALE                32
 
@@ -48,7 +88,7 @@
 #define Inv(sq)             (nsquare-1-sq)
 #define PcOnSq(k,i)         fv_kp[k][i]
 #define PcPcOn(i,j)         fv_pp[i][j]
-#define PcPcOnSq(k,i,j)     pc_on_sq[k][i][j]
+#define PcPcOnSq(k,i,j)     kpp_value(e,k,i,j)
 
 #define I2HandPawn(hand)    (((hand) & HAND_FU_MASK) >> HAND_FU_SHIFT)
 #define I2HandLance(hand)   (((hand) & HAND_KY_MASK) >> HAND_KY_SHIFT)
@@ -185,161 +225,1667 @@ enum { pos_n = fe_end * ( fe_end + 1 ) / 2 };
 
 #endif
 
-namespace {
-	short p_value[31];
+#if !defined(EVAL_MICRO)
+// ]xNgꎮBwb_݂̃C[W(image)ƁA̒̊ee[uւ̃|C^B
+// KPP  int16 ̂(kpp)Aʂ̈ʒuƂ̃Vtgʂŏk߂ int8 ̂(kpp8)̂ǂ炩B
+// int8 Ɏ܂ȂĺAʂ̑gƂ̗OXg(exc)Ɍ̒l̂܂܎B
+// mirror ̂Ƃ KPP, KKP ʂ 5-9؂ɂ镪A1-4؂̂Ƃ͍E]ĈB
+// ʂ̔ԍ fvperm ŕtւĂ邱ƂAǖʂʂƂ fmap B
+struct EvalImage {
+	struct Exception {
+		uint16_t partner;		// g̏̓(傫 exc_index ̍s)
+		int16_t  value;
+	};
+	struct ListIndex {
+		short l0, l1;			// list0, list1 ɓ
+	};
+	struct FeatureMap {
+		uint16_t  perm[fe_end];				// []̔ԍ] ̕]xNg̒ł̔ԍ
+		uint16_t  inv[fe_end];				// perm ̋t
+		short     mirror_fe[fe_end];		// tւԍł̍E]
+		ListIndex kp_list[PIECE_NONE][0xA0];	// [][Տ̍W]BʂƔՊO -1
+		ListIndex hand_list[2][HI+1][19];	// [][][]
+	};
+
+	char *image;
+	bool  mapped;				// image t@C mmap ̂
+	bool  mirror;				// ʂ̈ʒu̓Y king_slot[] ̂̂
+#if defined(_MSC_VER) || defined(_WIN32)
+	HANDLE map_handle;
+#endif
+	const short    (*kpp)[pos_n];			// [ʂ̈ʒu][OpCfbNX](int16 ̂Ƃ)
+	const int8_t   (*kpp8)[pos_n];			// [ʂ̈ʒu][OpCfbNX](int8 ̂Ƃ)
+	const uint8_t  *kpp_shift;				// [ʂ̈ʒu] kpp8 ̒lbitɂ炷
+	const uint32_t (*exc_index)[fe_end + 1];	// [ʂ̈ʒu][] exc ̊Jnʒu
+	const Exception *exc;
+	const short    (*kkp)[nsquare][fe_end];	// [][][]
+	const int      (*kk)[nsquare];			// [][](mirror łS)
+	const FeatureMap *fmap;
+};
+#endif
+
+namespace {
+	short p_value[31];
+
+#if !defined(EVAL_MICRO)
+  //short fv_pp[pp_bend][pp_end];
+  //short fv_kp[nsquare][kp_end];
+	EvalImage *volatile eval_cur;	// ]ɎgĂ]xNg
+
+	// evalreload ōւ́BT̃XbhQƂȂȂ
+	std::vector<EvalImage *> eval_retired;
+	const EvalImage *eval_last;		// O̒TŎg
+	std::string eval_name;			// gĂ̂̃t@C(ǂݍ݂ɐƂς)
+
+	// œǂݍݒ̕]xNg
+	HelperThread reload_thread;
+	std::string reload_name;
+	EvalImage *reload_image;
+	volatile bool reload_busy, reload_done;
+
+	// EvalNuma ̂Ƃ NUMA m[hƂ̕ƁǍ
+	std::vector<EvalImage *> eval_replica;
+	const EvalImage *replica_src;
+
+	// T͒TJnɎ́AȊO eval_cur g
+	inline const EvalImage &eval_table(const int threadID)
+	{
+		const EvalImage *img = Threads[threadID].evalImage;
+		return img ? *img : *eval_cur;
+	}
+
+	// KPP ̎OpCfbNXBpc_on_sq[k][i][j] == pc_on_sq[k][j][i] Ȃ̂ i >= j ̑
+	int kpp_tri[fe_end];			// kpp_tri[i] = i * (i + 1) / 2
+	inline int kpp_index(const int i, const int j)
+	{
+		const int hi = std::max(i, j);
+		return kpp_tri[hi] + (i + j - hi);
+	}
+
+	// E]Bmirror_sq[] ͋؂ 10- ɂʒuAmirror_fe[] ͂̈ʒuɒu̓(͂̂܂)
+	enum { nking_mirror = 45 };		// 5-9
+	int mirror_sq[nsquare];
+	int mirror_fe[fe_end];
+	int king_slot[nsquare];			// ʂ 5-9؂̕Ƃ̋ʂ̈ʒu̓Y(1-4؂͔]ʒû)
+	int slot_sq[nking_mirror];
+	inline bool king_left(const int sq) { return sq % 9 < 4; }	// 1-4
+
+	// KPP, KKP ʂ̈ʒu̓YBleft ɂ͓ʂE]ĈԂ
+	inline int king_index(const EvalImage &e, const int sq, bool &left)
+	{
+		left = e.mirror && king_left(sq);
+		return e.mirror ? king_slot[sq] : sq;
+	}
+	inline void mirror_list(const EvalImage &e, int list[], const int nlist)
+	{
+		const short *m = e.fmap->mirror_fe;
+		for (int i = 0; i < nlist; i++) list[i] = m[list[i]];
+	}
+
+	// KPP ̒l1(vZp)
+	inline int kpp_value(const EvalImage &e, const int k, const int i, const int j)
+	{
+		const int idx = kpp_index(i, j);
+		if (e.kpp) return e.kpp[k][idx];
+
+		const int q = e.kpp8[k][idx];
+		if (q != 0) return q * (1 << e.kpp_shift[k]);
+
+		// O int8  0 ɂĂ
+		const int hi = std::max(i, j);
+		const int lo = i + j - hi;
+		for (uint32_t n = e.exc_index[k][hi]; n < e.exc_index[k][hi + 1]; n++) {
+			if (e.exc[n].partner == lo) return e.exc[n].value;
+		}
+		return 0;
+	}
+
+	// ʂ̃Xgɕבւ(ʂ2񌻂Ȃ)B
+	// bits ɂ list Ɋ܂܂ʂ̃rbg𗧂ĂĕԂ
+	enum { LIST_BITS = (fe_end + 31) / 32 };
+	void sort_list(int list[], const int nlist, uint32_t bits[LIST_BITS])
+	{
+		int i, n = 0;
+		memset(bits, 0, LIST_BITS * sizeof(uint32_t));
+		for (i = 0; i < nlist; i++) bits[list[i] >> 5] |= 1u << (list[i] & 31);
+		for (i = 0; i < LIST_BITS; i++) {
+			uint32_t b = bits[i];
+			while (b) {
+				unsigned long id;
+				_BitScanForward(&id, b);
+				b &= b - 1;
+				list[n++] = i * 32 + int(id);
+			}
+		}
+	}
+
+	// int8  KPP ŁAXgɊ܂܂g̗O̒l𑫂
+	inline int kpp_exc_sum(const EvalImage &e, const int k, const int list[], const int nlist, const uint32_t bits[LIST_BITS])
+	{
+		int sum = 0;
+		for (int i = 0; i < nlist; i++) {
+			for (uint32_t n = e.exc_index[k][list[i]]; n < e.exc_index[k][list[i] + 1]; n++) {
+				const int lo = e.exc[n].partner;
+				if (bits[lo >> 5] & (1u << (lo & 31))) sum += e.exc[n].value;
+			}
+		}
+		return sum;
+	}
+
+	// KPP ̑SvZBlist0/list1 ͏ɕׂĂ邱ƁB
+	// kpp0/kpp1  KPP[]/KPP[Inv()]BT  short(int16) int8_t
+	typedef void (*KppSumFunc)(const short *kpp0, const short *kpp1, const int list0[], const int list1[],
+	                           const int nlist, int &sum0, int &sum1);
+	typedef void (*Kpp8SumFunc)(const int8_t *kpp0, const int8_t *kpp1, const int list0[], const int list1[],
+	                            const int nlist, int &sum0, int &sum1);
+
+	template<typename T>
+	void kpp_sum_scalar(const T *kpp0, const T *kpp1, const int list0[], const int list1[],
+	                    const int nlist, int &sum0, int &sum1)
+	{
+		int s0 = 0, s1 = 0;
+		for (int i = 1; i < nlist; i++) {
+			const T *row0 = kpp0 + kpp_tri[list0[i]];
+			const T *row1 = kpp1 + kpp_tri[list1[i]];
+			for (int j = 0; j < i; j++) {
+				s0 += row0[list0[j]];
+				s1 += row1[list1[j]];
+			}
+		}
+		sum0 = s0;
+		sum1 = s1;
+	}
+
+#if defined(USE_EVAL_SIMD)
+	// 8 pinsrw ŋl߂āA32bit ɍLđ
+	TARGET_SSE41
+	void kpp_sum_sse41(const short *kpp0, const short *kpp1, const int list0[], const int list1[],
+	                   const int nlist, int &sum0, int &sum1)
+	{
+		__m128i acc0 = _mm_setzero_si128();
+		__m128i acc1 = _mm_setzero_si128();
+		int s0 = 0, s1 = 0;
+		for (int i = 1; i < nlist; i++) {
+			const short *row0 = kpp0 + kpp_tri[list0[i]];
+			const short *row1 = kpp1 + kpp_tri[list1[i]];
+			int j = 0;
+			for (; j + 8 <= i; j += 8) {
+				__m128i v0 = _mm_cvtsi32_si128(row0[list0[j]]);
+				__m128i v1 = _mm_cvtsi32_si128(row1[list1[j]]);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 1]], 1);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 1]], 1);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 2]], 2);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 2]], 2);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 3]], 3);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 3]], 3);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 4]], 4);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 4]], 4);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 5]], 5);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 5]], 5);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 6]], 6);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 6]], 6);
+				v0 = _mm_insert_epi16(v0, row0[list0[j + 7]], 7);
+				v1 = _mm_insert_epi16(v1, row1[list1[j + 7]], 7);
+				acc0 = _mm_add_epi32(acc0, _mm_cvtepi16_epi32(v0));
+				acc1 = _mm_add_epi32(acc1, _mm_cvtepi16_epi32(v1));
+				acc0 = _mm_add_epi32(acc0, _mm_cvtepi16_epi32(_mm_srli_si128(v0, 8)));
+				acc1 = _mm_add_epi32(acc1, _mm_cvtepi16_epi32(_mm_srli_si128(v1, 8)));
+			}
+			for (; j < i; j++) {
+				s0 += row0[list0[j]];
+				s1 += row1[list1[j]];
+			}
+		}
+		acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc1 = _mm_add_epi32(acc1, _mm_shuffle_epi32(acc1, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, _MM_SHUFFLE(2, 3, 0, 1)));
+		acc1 = _mm_add_epi32(acc1, _mm_shuffle_epi32(acc1, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum0 = s0 + _mm_cvtsi128_si32(acc0);
+		sum1 = s1 + _mm_cvtsi128_si32(acc1);
+	}
+
+	// vpgatherdd  8 32bit ǂ݂A 16bit 𕄍gđB
+	// row[l] ̗̎vf܂œǂނAl < sԍ Ȃ̂œs̒Ɏ܂
+	TARGET_AVX2
+	void kpp_sum_avx2(const short *kpp0, const short *kpp1, const int list0[], const int list1[],
+	                  const int nlist, int &sum0, int &sum1)
+	{
+		const __m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i acc0 = _mm256_setzero_si256();
+		__m256i acc1 = _mm256_setzero_si256();
+		for (int i = 1; i < nlist; i++) {
+			const int *row0 = reinterpret_cast<const int *>(kpp0 + kpp_tri[list0[i]]);
+			const int *row1 = reinterpret_cast<const int *>(kpp1 + kpp_tri[list1[i]]);
+			int j = 0;
+			for (; j + 8 <= i; j += 8) {
+				const __m256i idx0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(list0 + j));
+				const __m256i idx1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(list1 + j));
+				const __m256i g0 = _mm256_i32gather_epi32(row0, idx0, 2);
+				const __m256i g1 = _mm256_i32gather_epi32(row1, idx1, 2);
+				acc0 = _mm256_add_epi32(acc0, _mm256_srai_epi32(_mm256_slli_epi32(g0, 16), 16));
+				acc1 = _mm256_add_epi32(acc1, _mm256_srai_epi32(_mm256_slli_epi32(g1, 16), 16));
+			}
+			if (j < i) {
+				const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(i - j), iota);
+				const __m256i idx0 = _mm256_maskload_epi32(list0 + j, mask);
+				const __m256i idx1 = _mm256_maskload_epi32(list1 + j, mask);
+				const __m256i g0 = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), row0, idx0, mask, 2);
+				const __m256i g1 = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), row1, idx1, mask, 2);
+				acc0 = _mm256_add_epi32(acc0, _mm256_srai_epi32(_mm256_slli_epi32(g0, 16), 16));
+				acc1 = _mm256_add_epi32(acc1, _mm256_srai_epi32(_mm256_slli_epi32(g1, 16), 16));
+			}
+		}
+		__m128i s0 = _mm_add_epi32(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+		__m128i s1 = _mm_add_epi32(_mm256_castsi256_si128(acc1), _mm256_extracti128_si256(acc1, 1));
+		s0 = _mm_add_epi32(s0, _mm_shuffle_epi32(s0, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 = _mm_add_epi32(s1, _mm_shuffle_epi32(s1, _MM_SHUFFLE(1, 0, 3, 2)));
+		s0 = _mm_add_epi32(s0, _mm_shuffle_epi32(s0, _MM_SHUFFLE(2, 3, 0, 1)));
+		s1 = _mm_add_epi32(s1, _mm_shuffle_epi32(s1, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum0 = _mm_cvtsi128_si32(s0);
+		sum1 = _mm_cvtsi128_si32(s1);
+	}
+
+	// int8 ŁB8 pinsrb ŋl߂āA32bit ɍLđ
+	TARGET_SSE41
+	inline __m128i gather8_epi8(const int8_t *row, const int list[])
+	{
+		__m128i v = _mm_cvtsi32_si128(uint8_t(row[list[0]]));
+		v = _mm_insert_epi8(v, row[list[1]], 1);
+		v = _mm_insert_epi8(v, row[list[2]], 2);
+		v = _mm_insert_epi8(v, row[list[3]], 3);
+		v = _mm_insert_epi8(v, row[list[4]], 4);
+		v = _mm_insert_epi8(v, row[list[5]], 5);
+		v = _mm_insert_epi8(v, row[list[6]], 6);
+		v = _mm_insert_epi8(v, row[list[7]], 7);
+		return v;
+	}
+
+	TARGET_SSE41
+	void kpp8_sum_sse41(const int8_t *kpp0, const int8_t *kpp1, const int list0[], const int list1[],
+	                    const int nlist, int &sum0, int &sum1)
+	{
+		__m128i acc0 = _mm_setzero_si128();
+		__m128i acc1 = _mm_setzero_si128();
+		int s0 = 0, s1 = 0;
+		for (int i = 1; i < nlist; i++) {
+			const int8_t *row0 = kpp0 + kpp_tri[list0[i]];
+			const int8_t *row1 = kpp1 + kpp_tri[list1[i]];
+			int j = 0;
+			for (; j + 8 <= i; j += 8) {
+				const __m128i v0 = gather8_epi8(row0, list0 + j);
+				const __m128i v1 = gather8_epi8(row1, list1 + j);
+				acc0 = _mm_add_epi32(acc0, _mm_cvtepi8_epi32(v0));
+				acc1 = _mm_add_epi32(acc1, _mm_cvtepi8_epi32(v1));
+				acc0 = _mm_add_epi32(acc0, _mm_cvtepi8_epi32(_mm_srli_si128(v0, 4)));
+				acc1 = _mm_add_epi32(acc1, _mm_cvtepi8_epi32(_mm_srli_si128(v1, 4)));
+			}
+			for (; j < i; j++) {
+				s0 += row0[list0[j]];
+				s1 += row1[list1[j]];
+			}
+		}
+		acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc1 = _mm_add_epi32(acc1, _mm_shuffle_epi32(acc1, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc0 = _mm_add_epi32(acc0, _mm_shuffle_epi32(acc0, _MM_SHUFFLE(2, 3, 0, 1)));
+		acc1 = _mm_add_epi32(acc1, _mm_shuffle_epi32(acc1, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum0 = s0 + _mm_cvtsi128_si32(acc0);
+		sum1 = s1 + _mm_cvtsi128_si32(acc1);
+	}
+
+	// int8 ŁB1byte Pʂ̓Y 32bit ǂ݂Aŉ byte 𕄍gđB
+	// Ō̋ʂ̈ʒu̖ł KPP ̌3byte ܂œǂނAɕʂ̃e[u
+	TARGET_AVX2
+	void kpp8_sum_avx2(const int8_t *kpp0, const int8_t *kpp1, const int list0[], const int list1[],
+	                   const int nlist, int &sum0, int &sum1)
+	{
+		const __m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i acc0 = _mm256_setzero_si256();
+		__m256i acc1 = _mm256_setzero_si256();
+		for (int i = 1; i < nlist; i++) {
+			const int *row0 = reinterpret_cast<const int *>(kpp0 + kpp_tri[list0[i]]);
+			const int *row1 = reinterpret_cast<const int *>(kpp1 + kpp_tri[list1[i]]);
+			int j = 0;
+			for (; j + 8 <= i; j += 8) {
+				const __m256i idx0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(list0 + j));
+				const __m256i idx1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(list1 + j));
+				const __m256i g0 = _mm256_i32gather_epi32(row0, idx0, 1);
+				const __m256i g1 = _mm256_i32gather_epi32(row1, idx1, 1);
+				acc0 = _mm256_add_epi32(acc0, _mm256_srai_epi32(_mm256_slli_epi32(g0, 24), 24));
+				acc1 = _mm256_add_epi32(acc1, _mm256_srai_epi32(_mm256_slli_epi32(g1, 24), 24));
+			}
+			if (j < i) {
+				const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(i - j), iota);
+				const __m256i idx0 = _mm256_maskload_epi32(list0 + j, mask);
+				const __m256i idx1 = _mm256_maskload_epi32(list1 + j, mask);
+				const __m256i g0 = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), row0, idx0, mask, 1);
+				const __m256i g1 = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), row1, idx1, mask, 1);
+				acc0 = _mm256_add_epi32(acc0, _mm256_srai_epi32(_mm256_slli_epi32(g0, 24), 24));
+				acc1 = _mm256_add_epi32(acc1, _mm256_srai_epi32(_mm256_slli_epi32(g1, 24), 24));
+			}
+		}
+		__m128i s0 = _mm_add_epi32(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+		__m128i s1 = _mm_add_epi32(_mm256_castsi256_si128(acc1), _mm256_extracti128_si256(acc1, 1));
+		s0 = _mm_add_epi32(s0, _mm_shuffle_epi32(s0, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 = _mm_add_epi32(s1, _mm_shuffle_epi32(s1, _MM_SHUFFLE(1, 0, 3, 2)));
+		s0 = _mm_add_epi32(s0, _mm_shuffle_epi32(s0, _MM_SHUFFLE(2, 3, 0, 1)));
+		s1 = _mm_add_epi32(s1, _mm_shuffle_epi32(s1, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum0 = _mm_cvtsi128_si32(s0);
+		sum1 = _mm_cvtsi128_si32(s1);
+	}
+#endif
+
+	EvalKernel eval_kernel = EVAL_KERNEL_SCALAR;
+	KppSumFunc kpp_sum = kpp_sum_scalar<short>;
+	Kpp8SumFunc kpp8_sum = kpp_sum_scalar<int8_t>;
+
+	// SvZ1񕪁Bprepare() ŕ\ʂ̈ʒu߂ēʂבւA
+	// prefetch() œǂޏǂ݂Asum()  KK, KKP, KPP 𑫂
+	struct FullEval {
+		int kb, kw, wk, kk;
+		int nlist;
+		int list0[NLIST], list1[NLIST];
+		uint32_t bits0[LIST_BITS], bits1[LIST_BITS];
+
+		void prepare(const EvalImage &e, const int sq_bk, const int sq_wk);
+		void prefetch(const EvalImage &e) const;
+		void sum(const EvalImage &e, int s[3]) const;
+		int sum_kkp(const EvalImage &e) const;
+		void sum_kpp(const EvalImage &e, int &sum0, int &sum1) const;
+	};
+
+	// list0, list1, nlist  make_list() ŋl߂Ă邱ƁBsq_bk, sq_wk ͐, ʂ̈ʒu
+	void FullEval::prepare(const EvalImage &e, const int sq_bk, const int sq_wk)
+	{
+		bool m0, m1;
+		kb = king_index(e, sq_bk, m0);
+		kw = king_index(e, Inv(sq_wk), m1);
+		wk = m0 ? mirror_sq[sq_wk] : sq_wk;
+		kk = e.kk[sq_bk][sq_wk];
+		// E]Ď\Ƃ́Aʂ 1-4؂ɂ鑤̓ʂ𔽓]
+		if (m0) mirror_list(e, list0, nlist);
+		if (m1) mirror_list(e, list1, nlist);
+		// ʑƌʑ̘a͓ƗȂ̂ŁAꂼꏸɕׂĎOp̍s𒼐ڈ
+		sort_list(list0, nlist, bits0);
+		sort_list(list1, nlist, bits1);
+	}
+
+	// KPP œǂޗvf̃LbVCǂ݂Bs̒ł͏ɓǂނ̂ŁAēCȂ΂
+	template<typename T>
+	void prefetch_kpp(const T *kpp, const int list[], const int nlist)
+	{
+		for (int i = 1; i < nlist; i++) {
+			const T *row = kpp + kpp_tri[list[i]];
+			uintptr_t last = 0;
+			for (int j = 0; j < i; j++) {
+				const uintptr_t line = reinterpret_cast<uintptr_t>(row + list[j]) >> 6;
+				if (line != last) {
+					EVAL_PREFETCH(row + list[j]);
+					last = line;
+				}
+			}
+		}
+	}
+
+	void FullEval::prefetch(const EvalImage &e) const
+	{
+		const short *kkp = e.kkp[kb][wk];
+		uintptr_t last = 0;
+		for (int i = 0; i < nlist; i++) {
+			const uintptr_t line = reinterpret_cast<uintptr_t>(kkp + list0[i]) >> 6;
+			if (line != last) {
+				EVAL_PREFETCH(kkp + list0[i]);
+				last = line;
+			}
+		}
+		if (e.kpp) {
+			prefetch_kpp(e.kpp[kb], list0, nlist);
+			prefetch_kpp(e.kpp[kw], list1, nlist);
+		} else {
+			prefetch_kpp(e.kpp8[kb], list0, nlist);
+			prefetch_kpp(e.kpp8[kw], list1, nlist);
+		}
+	}
+
+	// s[0]:ʂ KPP, s[1]:ʂ KPP, s[2]:KK+KKP(StateInfo::evalSum Ɠ)
+	void FullEval::sum(const EvalImage &e, int s[3]) const
+	{
+		s[2] = sum_kkp(e);
+		sum_kpp(e, s[0], s[1]);
+	}
+
+	inline int FullEval::sum_kkp(const EvalImage &e) const
+	{
+		const short *kkp = e.kkp[kb][wk];
+		int sum2 = kk;
+		for (int i = 0; i < nlist; i++) sum2 += kkp[list0[i]];
+		return sum2;
+	}
+
+	inline void FullEval::sum_kpp(const EvalImage &e, int &sum0, int &sum1) const
+	{
+		if (e.kpp) {
+			kpp_sum(e.kpp[kb], e.kpp[kw], list0, list1, nlist, sum0, sum1);
+		} else {
+			kpp8_sum(e.kpp8[kb], e.kpp8[kw], list0, list1, nlist, sum0, sum1);
+			sum0 = sum0 * (1 << e.kpp_shift[kb]) + kpp_exc_sum(e, kb, list0, nlist, bits0);
+			sum1 = sum1 * (1 << e.kpp_shift[kw]) + kpp_exc_sum(e, kw, list1, nlist, bits1);
+		}
+	}
+
+	// ]xNgp̗̈mہEBLinux ł 2MB Eɑ THP g킹
+	void* eval_alloc(size_t size)
+	{
+#if defined(_MSC_VER)
+		return _aligned_malloc(size, 64);
+#else
+		void *p;
+		if (posix_memalign(&p, 2 * 1024 * 1024, size) != 0) return NULL;
+#if defined(MADV_HUGEPAGE)
+		madvise(p, size, MADV_HUGEPAGE);
+#endif
+		return p;
+#endif
+	}
+	void eval_free(void *p)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	// t@C̐擪 offset ̈ʒuɈڂBlong  32bit ł 2GB 𒴂
+	int fseek64(FILE *fp, const uint64_t offset)
+	{
+#if defined(_MSC_VER)
+		return _fseeki64(fp, int64_t(offset), SEEK_SET);
+#elif defined(_WIN32)
+		return fseeko64(fp, int64_t(offset), SEEK_SET);
+#else
+		return fseeko(fp, off_t(offset), SEEK_SET);
+#endif
+	}
+
+	// ]xNg̃t@C`(FV3_MAP)
+	// wb_̌ KPP(Op), KKP, KK  4KB EɑĕׂB
+	// KPP  int8 ̂Ƃ́AKPP ̌ɃVtg, OXg̍, OXgB
+	// ł̕т̂܂܈(EvalImage::image)Ŏ̂ŁAt@C mmap 邾ŎgB
+	const char EVAL_FILE_MAGIC[8] = { 'B', 'N', 'N', 'H', 'E', 'V', 'A', 'L' };
+	const uint32_t EVAL_FILE_VERSION = 1;
+	const size_t EVAL_ALIGN = 4096;
+	enum { EVAL_KPP_INT16, EVAL_KPP_INT8 };
+
+	struct EvalFileHeader {
+		char     magic[8];
+		uint32_t version;
+		uint32_t header_size;
+		uint32_t nsquare;
+		uint32_t fe_end;
+		uint32_t fv_scale;
+		uint32_t kpp_format;	// EVAL_KPP_INT16 or EVAL_KPP_INT8
+		uint64_t kpp_offset;
+		uint64_t kkp_offset;
+		uint64_t kk_offset;
+		uint64_t file_size;
+		uint64_t checksum;		// header_size ȍ~̑S
+		// ȉ EVAL_KPP_INT8 ̂Ƃg(EVAL_KPP_INT16 ł 0)
+		uint64_t shift_offset;
+		uint64_t exc_index_offset;
+		uint64_t exc_offset;
+		uint64_t exc_count;
+		uint64_t mirror;		// 1 Ȃ KPP, KKP ͋ʂ 5-9؂̕(EvalImage::mirror)
+		uint64_t perm_offset;	// 0 łȂ KK ̌ɓʂ̕tւ(FeatureMap::perm)
+	};
+
+	inline size_t eval_align(size_t size)
+	{
+		return (size + EVAL_ALIGN - 1) & ~(EVAL_ALIGN - 1);
+	}
+
+	// ̎st@Cwb_
+	void init_eval_header(EvalFileHeader &h, uint32_t format = EVAL_KPP_INT16, uint64_t exc_count = 0, bool mirror = false, bool permuted = false)
+	{
+		const size_t nk = mirror ? size_t(nking_mirror) : size_t(nsquare);
+
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, EVAL_FILE_MAGIC, sizeof(h.magic));
+		h.version     = EVAL_FILE_VERSION;
+		h.header_size = uint32_t(EVAL_ALIGN);
+		h.nsquare     = nsquare;
+		h.fe_end      = fe_end;
+		h.fv_scale    = FV_SCALE;
+		h.kpp_format  = format;
+		h.kpp_offset  = h.header_size;
+		h.mirror      = mirror;
+		if (format == EVAL_KPP_INT8) {
+			h.exc_count        = exc_count;
+			h.shift_offset     = h.kpp_offset       + eval_align(nk * pos_n * sizeof(int8_t));
+			h.exc_index_offset = h.shift_offset     + eval_align(nk * sizeof(uint8_t));
+			h.exc_offset       = h.exc_index_offset + eval_align(nk * (fe_end + 1) * sizeof(uint32_t));
+			h.kkp_offset       = h.exc_offset       + eval_align(size_t(exc_count) * sizeof(EvalImage::Exception));
+		} else {
+			h.kkp_offset  = h.kpp_offset + eval_align(nk * pos_n * sizeof(short));
+		}
+		h.kk_offset   = h.kkp_offset + eval_align(nk * nsquare * fe_end * sizeof(short));
+		h.file_size   = h.kk_offset  + eval_align(size_t(nsquare) * nsquare * sizeof(int));
+		if (permuted) {
+			h.perm_offset = h.file_size;
+			h.file_size  += eval_align(fe_end * sizeof(uint16_t));
+		}
+	}
+
+	// Fletcher  64bit `FbNT(size  4 ̔{)
+	uint64_t eval_checksum(const char *p, size_t size)
+	{
+		const uint32_t *w = reinterpret_cast<const uint32_t *>(p);
+		uint64_t a = 0, b = 0;
+		for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+			a += w[i];
+			b += a;
+		}
+		return (b << 32) ^ a;
+	}
+
+	EvalImage::FeatureMap identity_map;		// tւĂȂ
+	void init_feature_map(EvalImage::FeatureMap &m, const uint16_t *perm);
+
+	void set_eval_tables(EvalImage *e)
+	{
+		const char *image = e->image;
+		const EvalFileHeader *h = reinterpret_cast<const EvalFileHeader *>(image);
+		e->mirror = (h->mirror != 0);
+		if (h->kpp_format == EVAL_KPP_INT8) {
+			e->kpp       = NULL;
+			e->kpp8      = reinterpret_cast<const int8_t (*)[pos_n]>(image + h->kpp_offset);
+			e->kpp_shift = reinterpret_cast<const uint8_t *>(image + h->shift_offset);
+			e->exc_index = reinterpret_cast<const uint32_t (*)[fe_end + 1]>(image + h->exc_index_offset);
+			e->exc       = reinterpret_cast<const EvalImage::Exception *>(image + h->exc_offset);
+		} else {
+			e->kpp       = reinterpret_cast<const short (*)[pos_n]>(image + h->kpp_offset);
+			e->kpp8      = NULL;
+			e->kpp_shift = NULL;
+			e->exc_index = NULL;
+			e->exc       = NULL;
+		}
+		e->kkp = reinterpret_cast<const short (*)[nsquare][fe_end]>(image + h->kkp_offset);
+		e->kk  = reinterpret_cast<const int (*)[nsquare]>(image + h->kk_offset);
+		if (e->fmap != &identity_map) delete e->fmap;
+		if (h->perm_offset) {
+			EvalImage::FeatureMap *m = new EvalImage::FeatureMap();
+			init_feature_map(*m, reinterpret_cast<const uint16_t *>(image + h->perm_offset));
+			e->fmap = m;
+		} else {
+			e->fmap = &identity_map;
+		}
+	}
+
+	inline EvalFileHeader *eval_header(const EvalImage *e)
+	{
+		return reinterpret_cast<EvalFileHeader *>(e->image);
+	}
+
+	// wb_ݒ肵(0)̕]xNgmۂ
+	EvalImage *new_eval_image(uint32_t format = EVAL_KPP_INT16, uint64_t exc_count = 0, bool mirror = false, bool permuted = false)
+	{
+		EvalFileHeader h;
+		init_eval_header(h, format, exc_count, mirror, permuted);
+		EvalImage *e = new EvalImage();
+		e->image = static_cast<char *>(eval_alloc(size_t(h.file_size)));
+		if (e->image == NULL) {
+			std::cerr << "Failed to allocate " << (h.file_size >> 20)
+			          << "MB for evaluation table." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		memset(e->image, 0, size_t(h.file_size));
+		memcpy(e->image, &h, sizeof(h));
+		set_eval_tables(e);
+		return e;
+	}
+
+	void free_eval_image(EvalImage *e)
+	{
+		if (e == NULL) return;
+		if (e->mapped) {
+#if defined(_MSC_VER) || defined(_WIN32)
+			UnmapViewOfFile(e->image);
+			CloseHandle(e->map_handle);
+#else
+			munmap(e->image, size_t(eval_header(e)->file_size));
+#endif
+		} else {
+			eval_free(e->image);
+		}
+		if (e->fmap != &identity_map) delete e->fmap;
+		delete e;
+	}
+
+	// fv3.bin  KPP ʂ̈ʒuƂɕāAXbhłꂼʂɊJēǂ
+	enum { FV_READ_THREADS = 4 };
+	struct FvReadTask {
+		const char *fname;
+		short (*kpp)[pos_n];
+		int n;
+		volatile bool failed;
+		uint64_t asymmetric[FV_READ_THREADS];	// [Xbh] kpp[k][i][j] != kpp[k][j][i] g̐
+	};
+
+	void read_fv_kpp(int idx, void *arg)
+	{
+		FvReadTask *t = static_cast<FvReadTask *>(arg);
+		FILE *fp = fopen(t->fname, "rb");
+		if (fp == NULL) {
+			t->failed = true;
+			return;
+		}
+		// KPP ͐`ŎĂ̂ŁAʂ̈ʒu 1܂Ƃ߂ēǂ i >= j ̑l߂B
+		// Opɂ [i][j]  [j][i] ͓lɂȂ̂ŁAĂΕςĐĂ
+		const size_t size = size_t(fe_end) * fe_end;
+		std::vector<short> buf(size);
+		for (int k = idx; k < nsquare && !t->failed; k += t->n) {
+			if (fseek64(fp, uint64_t(k) * size * sizeof(short)) != 0
+			 || fread(&buf[0], sizeof(short), size, fp) != size) {
+				t->failed = true;
+				break;
+			}
+			for (int i = 0; i < fe_end; i++) {
+				short *row = &t->kpp[k][kpp_index(i, 0)];
+				memcpy(row, &buf[size_t(i) * fe_end], (i + 1) * sizeof(short));
+				for (int j = 0; j < i; j++) {
+					const short v = buf[size_t(j) * fe_end + i];
+					if (row[j] != v) {
+						row[j] = short((row[j] + v) / 2);
+						t->asymmetric[idx]++;
+					}
+				}
+			}
+		}
+		fclose(fp);
+	}
+
+	// ] fv3.bin([81][1476][1476]  KPP, KKP, KK)ǂݍ
+	EvalImage *read_fv_bin(const char *fname)
+	{
+		FILE *fp = fopen(fname, "rb");
+		if (fp == NULL) return NULL;
+
+		EvalImage *e = new_eval_image();
+		EvalFileHeader *h = eval_header(e);
+		FvReadTask t = { fname, const_cast<short (*)[pos_n]>(e->kpp), std::min(cpu_count(), int(FV_READ_THREADS)), false, {0} };
+		int iret = 0;
+		do {
+			run_parallel(t.n, read_fv_kpp, &t);
+			if (t.failed) {
+				iret = -2;
+				break;
+			}
+			uint64_t asymmetric = 0;
+			for (int i = 0; i < t.n; i++) asymmetric += t.asymmetric[i];
+			if (asymmetric) {
+				std::cerr << fname << ": KPP is not symmetric in " << asymmetric
+				          << " pairs, using the average of kpp[k][i][j] and kpp[k][j][i]." << std::endl;
+			}
+
+			size_t size = size_t(nsquare) * nsquare * fe_end;
+			if (fseek64(fp, uint64_t(nsquare) * fe_end * fe_end * sizeof(short)) != 0
+			 || fread(e->image + h->kkp_offset, sizeof(short), size, fp) != size) {
+				iret = -2;
+				break;
+			}
+			size = size_t(nsquare) * nsquare;
+			if (fread(e->image + h->kk_offset, sizeof(int), size, fp) != size) {
+				iret = -2;
+				break;
+			}
+			if (fgetc(fp) != EOF) {
+				iret = -2;
+				break;
+			}
+		} while (0);
+		fclose(fp);
+
+		if (iret < 0) {
+			free_eval_image(e);
+			return NULL;
+		}
+		h->checksum = eval_checksum(e->image + h->header_size, size_t(h->file_size - h->header_size));
+		return e;
+	}
+
+	// FV3_MAP ǂݎp mmap Bt@CgvZXԂł̓y[WLbVLB
+	// `FbNT͑ŜǂނƂɂȂ̂ verify ̂Ƃ(fvconv, fvperm ̓)m߂
+	EvalImage *map_eval_file(const char *fname, const bool verify = false)
+	{
+		EvalImage *e = new EvalImage();
+		size_t size = 0;
+
+#if defined(_MSC_VER) || defined(_WIN32)
+		HANDLE fh = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fh == INVALID_HANDLE_VALUE) {
+			delete e;
+			return NULL;
+		}
+		LARGE_INTEGER li;
+		if (GetFileSizeEx(fh, &li)) size = size_t(li.QuadPart);
+		if (size >= EVAL_ALIGN) {
+			e->map_handle = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (e->map_handle != NULL) {
+				e->image = static_cast<char *>(MapViewOfFile(e->map_handle, FILE_MAP_READ, 0, 0, 0));
+				if (e->image == NULL) CloseHandle(e->map_handle);
+			}
+		}
+		CloseHandle(fh);
+#else
+		int fd = open(fname, O_RDONLY);
+		if (fd < 0) {
+			delete e;
+			return NULL;
+		}
+		struct stat st;
+		if (fstat(fd, &st) == 0) size = size_t(st.st_size);
+		if (size >= EVAL_ALIGN) {
+			void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p != MAP_FAILED) e->image = static_cast<char *>(p);
+		}
+		close(fd);
+#endif
+		if (e->image == NULL) {
+			std::cerr << fname << ": too small or mmap failed." << std::endl;
+			delete e;
+			return NULL;
+		}
+		e->mapped = true;
+
+		const EvalFileHeader *h = eval_header(e);
+		EvalFileHeader expect;
+		init_eval_header(expect, h->kpp_format, h->exc_count, h->mirror != 0, h->perm_offset != 0);
+		const char *error = NULL;
+		if (memcmp(h->magic, expect.magic, sizeof(h->magic)) != 0) {
+			error = "bad magic";
+		} else if (h->version != expect.version) {
+			error = "unsupported version";
+		} else if (h->kpp_format != EVAL_KPP_INT16 && h->kpp_format != EVAL_KPP_INT8) {
+			error = "unsupported KPP format";
+		} else if (h->mirror > 1) {
+			error = "unsupported mirror mode";
+		} else if (h->header_size != expect.header_size || h->nsquare != expect.nsquare
+		        || h->fe_end != expect.fe_end || h->fv_scale != expect.fv_scale
+		        || h->kpp_offset != expect.kpp_offset || h->kkp_offset != expect.kkp_offset
+		        || h->kk_offset != expect.kk_offset || h->file_size != expect.file_size
+		        || h->shift_offset != expect.shift_offset || h->exc_index_offset != expect.exc_index_offset
+		        || h->exc_offset != expect.exc_offset || h->perm_offset != expect.perm_offset
+		        || size != size_t(expect.file_size)) {
+			error = "dimension mismatch";
+		} else if (verify && h->checksum != eval_checksum(e->image + h->header_size, size - h->header_size)) {
+			error = "checksum mismatch";
+		} else if (h->perm_offset) {
+			// tւ 0 ` fe_end-1 ̕בւɂȂĂ邩
+			const uint16_t *perm = reinterpret_cast<const uint16_t *>(e->image + h->perm_offset);
+			std::vector<bool> used(fe_end);
+			for (int i = 0; i < fe_end && error == NULL; i++) {
+				if (perm[i] >= fe_end || used[perm[i]]) error = "bad feature permutation";
+				else used[perm[i]] = true;
+			}
+		}
+		if (error) {
+			std::cerr << fname << ": " << error << "." << std::endl;
+#if defined(_MSC_VER) || defined(_WIN32)
+			UnmapViewOfFile(e->image);
+			CloseHandle(e->map_handle);
+#else
+			munmap(e->image, size);
+#endif
+			delete e;
+			return NULL;
+		}
+		set_eval_tables(e);
+		return e;
+	}
+
+	// ʂ̈ʒu sq ł KPP, KKP ̒l(E]Ď]xNgȂ甽]Ĉ)B
+	// i, j, f ͕tւO̔ԍ
+	int kpp_value_sq(const EvalImage &e, const int sq, const int i, const int j)
+	{
+		const uint16_t *p = e.fmap->perm;
+		if (!e.mirror) return kpp_value(e, sq, p[i], p[j]);
+		if (king_left(sq)) return kpp_value(e, king_slot[sq], p[mirror_fe[i]], p[mirror_fe[j]]);
+		return kpp_value(e, king_slot[sq], p[i], p[j]);
+	}
+	int kkp_value_sq(const EvalImage &e, const int bk, const int wk, const int f)
+	{
+		const uint16_t *p = e.fmap->perm;
+		if (!e.mirror) return e.kkp[bk][wk][p[f]];
+		if (king_left(bk)) return e.kkp[king_slot[bk]][mirror_sq[wk]][p[mirror_fe[f]]];
+		return e.kkp[king_slot[bk]][wk][p[f]];
+	}
+
+	// ϊ̋ʂ̈ʒu̓Y k ɓlBE]Ď悤ɕϊƂ́A]lƂ̕ςɂ
+	int converted_kpp(const EvalImage &src, const bool mirror, const int k, const int i, const int j)
+	{
+		if (!mirror) return kpp_value_sq(src, k, i, j);
+		const int sq = slot_sq[k];
+		if (src.mirror) return kpp_value_sq(src, sq, i, j);
+		return (kpp_value_sq(src, sq, i, j) + kpp_value_sq(src, mirror_sq[sq], mirror_fe[i], mirror_fe[j])) / 2;
+	}
+	int converted_kkp(const EvalImage &src, const bool mirror, const int k, const int wk, const int f)
+	{
+		if (!mirror) return kkp_value_sq(src, k, wk, f);
+		const int sq = slot_sq[k];
+		if (src.mirror) return kkp_value_sq(src, sq, wk, f);
+		return (kkp_value_sq(src, sq, wk, f) + kkp_value_sq(src, mirror_sq[sq], mirror_sq[wk], mirror_fe[f])) / 2;
+	}
+
+	// ]xNǧ`ςBformat  KPP ̌^Amirror ͋ʂ 5-9؂̕B
+	// int8 ɂƂ́Aʂ̈ʒuƂ int8 Ɏ܂Ȃg 0.1% ȉɂȂԏVtgʂIсA
+	// ܂Ȃg͗OXgɌ̒lŎ(KKP, KK  int8 ɂȂ)B
+	// perm Γʂ̔ԍŕtւ̂ɂ(NULL ȂtւȂ)
+	EvalImage *convert_eval_image(const EvalImage &src, const uint32_t format, const bool mirror, const uint16_t *perm = NULL)
+	{
+		const int nk = mirror ? int(nking_mirror) : int(nsquare);
+		const int max_exc = pos_n / 1000;
+		std::vector<uint8_t> shift(nk);
+		std::vector<uint32_t> index(size_t(nk) * (fe_end + 1));
+		std::vector<EvalImage::Exception> exc;
+		std::vector<int> hist(65536);
+		std::vector<int> org(fe_end);		// [ϊ̔ԍ] tւO̔ԍ
+		int k, i, j, s, v;
+
+		for (i = 0; i < fe_end; i++) org[perm ? perm[i] : i] = i;
+		for (k = 0; k < nk && format == EVAL_KPP_INT8; k++) {
+			std::fill(hist.begin(), hist.end(), 0);
+			for (i = 1; i < fe_end; i++) {
+				for (j = 0; j < i; j++) hist[converted_kpp(src, mirror, k, org[i], org[j]) + 32768]++;
+			}
+			for (s = 0; s < 8; s++) {
+				// round(v / 2^s)  [-127, 127] ɓ͈
+				const int lo = -(127 << s) - (s ? (1 << (s - 1)) : 0);
+				const int hi = (127 << s) + (s ? (1 << (s - 1)) - 1 : 0);
+				int n = 0;
+				for (v = -32768; v < lo; v++) n += hist[v + 32768];
+				for (v = hi + 1; v < 32768; v++) n += hist[v + 32768];
+				if (n <= max_exc) break;
+			}
+			shift[k] = uint8_t(s);
+			const int lo = -(127 << s) - (s ? (1 << (s - 1)) : 0);
+			const int hi = (127 << s) + (s ? (1 << (s - 1)) - 1 : 0);
+			for (i = 0; i < fe_end; i++) {
+				index[k * (fe_end + 1) + i] = uint32_t(exc.size());
+				for (j = 0; j < i; j++) {
+					v = converted_kpp(src, mirror, k, org[i], org[j]);
+					if (v < lo || hi < v) {
+						EvalImage::Exception x;
+						x.partner = uint16_t(j);
+						x.value = int16_t(v);
+						exc.push_back(x);
+					}
+				}
+			}
+			index[k * (fe_end + 1) + fe_end] = uint32_t(exc.size());
+		}
+
+		EvalImage *e = new_eval_image(format, exc.size(), mirror, perm != NULL);
+		EvalFileHeader *h = eval_header(e);
+		short (*kpp)[pos_n] = const_cast<short (*)[pos_n]>(e->kpp);
+		int8_t (*kpp8)[pos_n] = const_cast<int8_t (*)[pos_n]>(e->kpp8);
+		for (k = 0; k < nk; k++) {
+			s = shift[k];
+			for (i = 1; i < fe_end; i++) {
+				for (j = 0; j < i; j++) {
+					v = converted_kpp(src, mirror, k, org[i], org[j]);
+					if (format != EVAL_KPP_INT8) {
+						kpp[k][kpp_index(i, j)] = short(v);
+						continue;
+					}
+					const int q = s ? (v + (1 << (s - 1))) >> s : v;
+					if (-127 <= q && q <= 127) kpp8[k][kpp_index(i, j)] = int8_t(q);
+				}
+			}
+		}
+		if (format == EVAL_KPP_INT8) {
+			memcpy(e->image + h->shift_offset, &shift[0], shift.size() * sizeof(uint8_t));
+			memcpy(e->image + h->exc_index_offset, &index[0], index.size() * sizeof(uint32_t));
+			if (!exc.empty()) memcpy(e->image + h->exc_offset, &exc[0], exc.size() * sizeof(EvalImage::Exception));
+		}
+
+		short (*kkp)[nsquare][fe_end] = const_cast<short (*)[nsquare][fe_end]>(e->kkp);
+		int (*kk)[nsquare] = const_cast<int (*)[nsquare]>(e->kk);
+		for (k = 0; k < nk; k++) {
+			for (i = 0; i < nsquare; i++) {
+				for (j = 0; j < fe_end; j++) kkp[k][i][j] = short(converted_kkp(src, mirror, k, i, org[j]));
+			}
+		}
+		for (i = 0; i < nsquare; i++) {
+			for (j = 0; j < nsquare; j++) {
+				kk[i][j] = (mirror && !src.mirror) ? (src.kk[i][j] + src.kk[mirror_sq[i]][mirror_sq[j]]) / 2 : src.kk[i][j];
+			}
+		}
+		if (perm) {
+			memcpy(e->image + h->perm_offset, perm, fe_end * sizeof(uint16_t));
+			set_eval_tables(e);
+		}
+		h->checksum = eval_checksum(e->image + h->header_size, size_t(h->file_size - h->header_size));
+		return e;
+	}
+
+	// ̖ Hand::h o
+	const uint32_t hand_mask[HI+1] = {
+		0, HAND_FU_MASK, HAND_KY_MASK, HAND_KE_MASK, HAND_GI_MASK, HAND_KI_MASK, HAND_KA_MASK, HAND_HI_MASK
+	};
+	const int hand_shift[HI+1] = {
+		0, HAND_FU_SHIFT, HAND_KY_SHIFT, HAND_KE_SHIFT, HAND_GI_SHIFT, HAND_KI_SHIFT, HAND_KA_SHIFT, HAND_HI_SHIFT
+	};
+	const int hand_max[HI+1] = { 0, 18, 4, 4, 4, 4, 2, 2 };
+
+	// ǖʂʂ̕\Aʂ̔ԍ perm ŕtւ̂ō(NULL ȂtւȂ)
+	void init_feature_map(EvalImage::FeatureMap &m, const uint16_t *perm)
+	{
+		// make_list() Ɠʂ̊蓖
+		short kp_index0[PIECE_NONE], kp_index1[PIECE_NONE];		// [] Տ̋(list0p, list1p)
+		short hand_index0[2][HI+1], hand_index1[2][HI+1];		// [][] (list0p, list1p)
+		for (int i = 0; i < PIECE_NONE; i++) { kp_index0[i] = kp_index1[i] = -1; }
+		kp_index0[SFU] = f_pawn;   kp_index1[SFU] = e_pawn;
+		kp_index0[SKY] = f_lance;  kp_index1[SKY] = e_lance;
+		kp_index0[SKE] = f_knight; kp_index1[SKE] = e_knight;
+		kp_index0[SGI] = f_silver; kp_index1[SGI] = e_silver;
+		kp_index0[SKI] = f_gold;   kp_index1[SKI] = e_gold;
+		kp_index0[SKA] = f_bishop; kp_index1[SKA] = e_bishop;
+		kp_index0[SHI] = f_rook;   kp_index1[SHI] = e_rook;
+		kp_index0[STO] = f_gold;   kp_index1[STO] = e_gold;
+		kp_index0[SNY] = f_gold;   kp_index1[SNY] = e_gold;
+		kp_index0[SNK] = f_gold;   kp_index1[SNK] = e_gold;
+		kp_index0[SNG] = f_gold;   kp_index1[SNG] = e_gold;
+		kp_index0[SUM] = f_horse;  kp_index1[SUM] = e_horse;
+		kp_index0[SRY] = f_dragon; kp_index1[SRY] = e_dragon;
+		for (int i = SFU; i <= SRY; i++) {
+			if (kp_index0[i] < 0) continue;
+			// ̋͐̋ f_  e_ ւ
+			kp_index0[i | GOTE] = kp_index1[i];
+			kp_index1[i | GOTE] = kp_index0[i];
+		}
+
+		hand_index0[BLACK][FU] = f_hand_pawn;   hand_index1[BLACK][FU] = e_hand_pawn;
+		hand_index0[BLACK][KY] = f_hand_lance;  hand_index1[BLACK][KY] = e_hand_lance;
+		hand_index0[BLACK][KE] = f_hand_knight; hand_index1[BLACK][KE] = e_hand_knight;
+		hand_index0[BLACK][GI] = f_hand_silver; hand_index1[BLACK][GI] = e_hand_silver;
+		hand_index0[BLACK][KI] = f_hand_gold;   hand_index1[BLACK][KI] = e_hand_gold;
+		hand_index0[BLACK][KA] = f_hand_bishop; hand_index1[BLACK][KA] = e_hand_bishop;
+		hand_index0[BLACK][HI] = f_hand_rook;   hand_index1[BLACK][HI] = e_hand_rook;
+		for (int i = FU; i <= HI; i++) {
+			hand_index0[WHITE][i] = hand_index1[BLACK][i];
+			hand_index1[WHITE][i] = hand_index0[BLACK][i];
+		}
+
+		for (int i = 0; i < fe_end; i++) {
+			m.perm[i] = uint16_t(perm ? perm[i] : i);
+			m.inv[m.perm[i]] = uint16_t(i);
+		}
+		for (int i = 0; i < fe_end; i++) m.mirror_fe[m.perm[i]] = short(m.perm[mirror_fe[i]]);
+		for (int i = 0; i < PIECE_NONE; i++) {
+			for (int z = 0; z < 0xA0; z++) {
+				const int sq = (z >> 4) >= 1 && (z >> 4) <= 9 && (z & 0x0F) >= 1 && (z & 0x0F) <= 9 ? NanohaTbl::z2sq[z] : -1;
+				if (kp_index0[i] < 0 || sq < 0) {
+					m.kp_list[i][z].l0 = m.kp_list[i][z].l1 = -1;
+				} else {
+					m.kp_list[i][z].l0 = short(m.perm[kp_index0[i] + sq]);
+					m.kp_list[i][z].l1 = short(m.perm[kp_index1[i] + Inv(sq)]);
+				}
+			}
+		}
+		for (int c = BLACK; c <= WHITE; c++) {
+			for (int pt = 0; pt <= HI; pt++) {
+				for (int n = 0; n < 19; n++) {
+					// 0̓ʂ͎gȂ
+					const bool used = n > 0 && n <= hand_max[pt];
+					m.hand_list[c][pt][n].l0 = used ? short(m.perm[hand_index0[c][pt] + n]) : -1;
+					m.hand_list[c][pt][n].l1 = used ? short(m.perm[hand_index1[c][pt] + n]) : -1;
+				}
+			}
+		}
+	}
+#endif
+}
+
+namespace NanohaTbl {
+	const short z2sq[] = {
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1,  0,  9, 18, 27, 36, 45, 54, 63, 72, -1, -1, -1, -1, -1, -1,
+		-1,  1, 10, 19, 28, 37, 46, 55, 64, 73, -1, -1, -1, -1, -1, -1,
+		-1,  2, 11, 20, 29, 38, 47, 56, 65, 74, -1, -1, -1, -1, -1, -1,
+		-1,  3, 12, 21, 30, 39, 48, 57, 66, 75, -1, -1, -1, -1, -1, -1,
+		-1,  4, 13, 22, 31, 40, 49, 58, 67, 76, -1, -1, -1, -1, -1, -1,
+		-1,  5, 14, 23, 32, 41, 50, 59, 68, 77, -1, -1, -1, -1, -1, -1,
+		-1,  6, 15, 24, 33, 42, 51, 60, 69, 78, -1, -1, -1, -1, -1, -1,
+		-1,  7, 16, 25, 34, 43, 52, 61, 70, 79, -1, -1, -1, -1, -1, -1,
+		-1,  8, 17, 26, 35, 44, 53, 62, 71, 80, -1, -1, -1, -1, -1, -1,
+	};
+}
+
+void Position::init_evaluate()
+{
+	int iret=0;
+#if !defined(EVAL_MICRO)
+	/*	const char *fname ="]xNg";
+
+	do {
+		size_t size;
+
+		fname = FV_BIN;
+		fp = fopen(fname, "rb");
+		if ( fp == NULL ) { iret = -2; break;}
+
+		size = pp_bend * pp_end;
+		if ( fread( fv_pp, sizeof(short), size, fp ) != size )
+		{
+			iret = -2;
+			break;
+		}
+
+		size = nsquare * kp_end;
+		if ( fread( fv_kp, sizeof(short), size, fp ) != size ) {
+			iret = -2;
+			break;
+		}
+
+		if (fgetc(fp) != EOF) {
+			iret = -2;
+			break;
+		}
+	} while (0);
+	if (fp) fclose( fp );
+	*/
+	for (int i = 0; i < fe_end; i++) kpp_tri[i] = i * (i + 1) / 2;
+
+	// E]̕\BՏ̋̓ʂ Ƃ̋N_ + ʒu ŁA؂ςĂui͕ςȂ
+	static const int fe_board[][3] = {		// N_, uʒu̍ŏƍŌ
+		{ f_pawn,    9, 80 }, { e_pawn,   0, 71 },
+		{ f_lance,   9, 80 }, { e_lance,  0, 71 },
+		{ f_knight, 18, 80 }, { e_knight, 0, 62 },
+		{ f_silver,  0, 80 }, { e_silver, 0, 80 },
+		{ f_gold,    0, 80 }, { e_gold,   0, 80 },
+		{ f_bishop,  0, 80 }, { e_bishop, 0, 80 },
+		{ f_horse,   0, 80 }, { e_horse,  0, 80 },
+		{ f_rook,    0, 80 }, { e_rook,   0, 80 },
+		{ f_dragon,  0, 80 }, { e_dragon, 0, 80 },
+	};
+	for (int sq = 0; sq < nsquare; sq++) mirror_sq[sq] = sq / 9 * 9 + 8 - sq % 9;
+	for (int i = 0; i < fe_hand_end; i++) mirror_fe[i] = i;
+	for (size_t n = 0; n < sizeof(fe_board) / sizeof(fe_board[0]); n++) {
+		for (int sq = fe_board[n][1]; sq <= fe_board[n][2]; sq++) mirror_fe[fe_board[n][0] + sq] = fe_board[n][0] + mirror_sq[sq];
+	}
+	for (int sq = 0; sq < nsquare; sq++) {
+		if (king_left(sq)) continue;
+		king_slot[sq] = sq / 9 * 5 + sq % 9 - 4;
+		slot_sq[king_slot[sq]] = sq;
+	}
+	for (int sq = 0; sq < nsquare; sq++) {
+		if (king_left(sq)) king_slot[sq] = king_slot[mirror_sq[sq]];
+	}
+	init_feature_map(identity_map, NULL);
+	// g钆ňԑ
+	for (int k = EVAL_KERNEL_NB - 1; k >= 0 && !set_eval_kernel(EvalKernel(k)); k--) ;
+	if (eval_cur == NULL) {
+		// ϊς݂ FV3_MAP  mmap ŋLAΏ] fv3.bin ǂ
+		eval_cur = map_eval_file(FV3_MAP);
+		eval_name = FV3_MAP;
+		if (eval_cur == NULL) {
+			eval_cur = read_fv_bin(FV3_BIN);
+			eval_name = FV3_BIN;
+		}
+		if (eval_cur == NULL) {
+			iret = -2;
+			eval_cur = new_eval_image();
+			eval_name.clear();
+		}
+	}
+
+	if (iret < 0) {
+		// ǂ߂ȂƂ͋ŕ]
+#if !defined(NDEBUG)
+		std::cerr << "Can't load " FV_BIN "." << std::endl;
+#endif
+#if defined(CSADLL) || defined(CSA_DIRECT)
+		::MessageBox(NULL, "]xNg[hł܂\nI܂", "Error!", MB_OK);
+		exit(1);
+#endif	// defined(CSA_DLL) || defined(CSA_DIRECT)
+	}
+#endif
+
+	for (int i = 0; i < 31; i++) { p_value[i]       = 0; }
+
+	p_value[15+pawn]       = DPawn;
+	p_value[15+lance]      = DLance;
+	p_value[15+knight]     = DKnight;
+	p_value[15+silver]     = DSilver;
+	p_value[15+gold]       = DGold;
+	p_value[15+bishop]     = DBishop;
+	p_value[15+rook]       = DRook;
+	p_value[15+king]       = DKing;
+	p_value[15+pro_pawn]   = DProPawn;
+	p_value[15+pro_lance]  = DProLance;
+	p_value[15+pro_knight] = DProKnight;
+	p_value[15+pro_silver] = DProSilver;
+	p_value[15+horse]      = DHorse;
+	p_value[15+dragon]     = DDragon;
+
+	p_value[15-pawn]          = p_value[15+pawn];
+	p_value[15-lance]         = p_value[15+lance];
+	p_value[15-knight]        = p_value[15+knight];
+	p_value[15-silver]        = p_value[15+silver];
+	p_value[15-gold]          = p_value[15+gold];
+	p_value[15-bishop]        = p_value[15+bishop];
+	p_value[15-rook]          = p_value[15+rook];
+	p_value[15-king]          = p_value[15+king];
+	p_value[15-pro_pawn]      = p_value[15+pro_pawn];
+	p_value[15-pro_lance]     = p_value[15+pro_lance];
+	p_value[15-pro_knight]    = p_value[15+pro_knight];
+	p_value[15-pro_silver]    = p_value[15+pro_silver];
+	p_value[15-horse]         = p_value[15+horse];
+	p_value[15-dragon]        = p_value[15+dragon];
+
+#if !defined(EVAL_MICRO)
+#endif
+}
+
+// init_evaluate() Ŋmۂ]xNg̉
+void Position::release_evaluate()
+{
+#if !defined(EVAL_MICRO)
+	if (reload_busy) reload_thread.join();
+	free_eval_image(reload_image);
+	reload_image = NULL;
+	for (size_t i = 0; i < eval_replica.size(); i++) free_eval_image(eval_replica[i]);
+	eval_replica.clear();
+	for (size_t i = 0; i < eval_retired.size(); i++) free_eval_image(eval_retired[i]);
+	eval_retired.clear();
+	free_eval_image(eval_cur);
+	eval_cur = NULL;
+#endif
+}
+
+bool eval_kernel_supported(EvalKernel k)
+{
+	switch (k) {
+	case EVAL_KERNEL_SCALAR: return true;
+#if defined(USE_EVAL_SIMD)
+	case EVAL_KERNEL_SSE41:  return cpu_has_sse41();
+	case EVAL_KERNEL_AVX2:   return cpu_has_avx2();
+#endif
+	default:                 return false;
+	}
+}
+
+bool set_eval_kernel(EvalKernel k)
+{
+#if !defined(EVAL_MICRO)
+	if (!eval_kernel_supported(k)) return false;
+	switch (k) {
+#if defined(USE_EVAL_SIMD)
+	case EVAL_KERNEL_SSE41:
+		kpp_sum  = kpp_sum_sse41;
+		kpp8_sum = kpp8_sum_sse41;
+		break;
+	case EVAL_KERNEL_AVX2:
+		kpp_sum  = kpp_sum_avx2;
+		kpp8_sum = kpp8_sum_avx2;
+		break;
+#endif
+	default:
+		kpp_sum  = kpp_sum_scalar<short>;
+		kpp8_sum = kpp_sum_scalar<int8_t>;
+		break;
+	}
+	eval_kernel = k;
+	return true;
+#else
+	return k == EVAL_KERNEL_SCALAR;
+#endif
+}
+
+EvalKernel get_eval_kernel()
+{
+#if !defined(EVAL_MICRO)
+	return eval_kernel;
+#else
+	return EVAL_KERNEL_SCALAR;
+#endif
+}
+
+const char *eval_kernel_name(EvalKernel k)
+{
+	static const char *name[EVAL_KERNEL_NB] = { "scalar", "sse4.1", "avx2" };
+	return (k < EVAL_KERNEL_NB) ? name[k] : "unknown";
+}
+
+// ]xNgǂݍށB擪 FV3_MAP ̃wb_Ȃ mmap AłȂΏ] fv3.bin ƂēǂށB
+// verify Ȃ FV3_MAP ̃`FbNTm߂
+EvalImage *load_eval_image(const char *fname, bool verify)
+{
+#if !defined(EVAL_MICRO)
+	char magic[sizeof(EVAL_FILE_MAGIC)] = {0};
+	FILE *fp = fopen(fname, "rb");
+	if (fp == NULL) return NULL;
+	const bool is_map = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)
+	                     && memcmp(magic, EVAL_FILE_MAGIC, sizeof(magic)) == 0);
+	fclose(fp);
+	return is_map ? map_eval_file(fname, verify) : read_fv_bin(fname);
+#else
+	(void)fname; (void)verify;
+	return NULL;
+#endif
+}
+
+// ]Ɏg]xNg؂ւA܂ł̂̂ԂB
+// ]nbV͏Aǖ(StateInfo)ɎcĂ镔a͌ĂяoŌvZ
+EvalImage *set_eval_image(EvalImage *img)
+{
+#if !defined(EVAL_MICRO)
+	EvalImage *prev = eval_cur;
+	eval_cur = img;
+	EvalHash.clear();
+	return prev;
+#else
+	return img;
+#endif
+}
+
+EvalImage *get_eval_image()
+{
+#if !defined(EVAL_MICRO)
+	return eval_cur;
+#else
+	return NULL;
+#endif
+}
+
+void release_eval_image(EvalImage *img)
+{
+#if !defined(EVAL_MICRO)
+	assert(img != eval_cur);
+	free_eval_image(img);
+#else
+	(void)img;
+#endif
+}
+
+#if !defined(EVAL_MICRO)
+namespace {
+	void reload_task(void *)
+	{
+		reload_image = load_eval_image(reload_name.c_str());
+		reload_done = true;
+	}
+
+	// ւÂ̂ŁAǂ̃XbhTɎgĂȂ̂
+	void collect_retired()
+	{
+		for (size_t i = 0; i < eval_retired.size(); ) {
+			bool used = false;
+			for (int t = 0; t < MAX_THREADS; t++) used |= (Threads[t].evalImage == eval_retired[i]);
+			if (used) {
+				i++;
+				continue;
+			}
+			free_eval_image(eval_retired[i]);
+			eval_retired[i] = eval_retired.back();
+			eval_retired.pop_back();
+		}
+	}
+}
+#endif
+
+// ]xNg𗠂œǂݎn߂BǂݏI poll_eval_reload() ōւB
+// force łȂ΁Â̂ƓO͓ǂݒȂBǂݍݒȂ false
+bool start_eval_reload(const std::string &fname, bool force)
+{
+#if !defined(EVAL_MICRO)
+	if (reload_busy) return false;
+	if (!force && fname == eval_name) return true;
+	reload_name = fname;
+	reload_done = false;
+	reload_busy = true;
+	reload_thread.start(reload_task, NULL);
+	return true;
+#else
+	(void)fname; (void)force;
+	return false;
+#endif
+}
+
+// ǂݍ݂IĂ eval_cur ւBTɌĂł悭A
+// T̃Xbh͒TJn̂̂gA̒TV̂ɂȂ
+void poll_eval_reload(bool wait)
+{
+#if !defined(EVAL_MICRO)
+	if (reload_busy && (reload_done || wait)) {
+		reload_thread.join();
+		reload_busy = false;
+		if (reload_image == NULL) {
+			std::cout << "info string EvalFile " << reload_name << " failed to load" << std::endl;
+		} else {
+			EvalImage *prev = eval_cur;
+			eval_retired.push_back(prev);
+			eval_cur = reload_image;
+			eval_name = reload_name;
+			reload_image = NULL;
+			std::cout << "info string EvalFile " << reload_name << " loaded (" << eval_image_info(eval_cur) << ")" << std::endl;
+		}
+	}
+	collect_retired();
+#else
+	(void)wait;
+#endif
+}
+
+#if !defined(EVAL_MICRO)
+namespace {
+	struct ReplicaTask {
+		const EvalImage *src;
+		EvalImage **dst;
+	};
+
+	// m[h idx œXbhmۂďނ̂ŁAmbind gȂĂ
+	// first touch ł̃m[h̃ɂȂ
+	void make_replica(int idx, void *arg)
+	{
+		const ReplicaTask *t = static_cast<const ReplicaTask *>(arg);
+		const size_t size = size_t(eval_header(t->src)->file_size);
+		numa_bind_self(idx);
+		EvalImage *e = new EvalImage();
+		e->image = static_cast<char *>(eval_alloc(size));
+		if (e->image == NULL) {
+			delete e;
+			t->dst[idx] = NULL;
+			return;
+		}
+		numa_bind_memory(e->image, size, idx);
+		memcpy(e->image, t->src->image, size);
+		set_eval_tables(e);
+		t->dst[idx] = e;
+	}
+
+	// Xbh NUMA m[hɕĂƂ́A]xNgm[hƂɕB
+	// ςĂ΍蒼AÂ͎gȂȂĂ
+	void update_eval_replicas()
+	{
+		const int nodes = Threads.numa_nodes();
+		if (nodes > 1 && replica_src == eval_cur && int(eval_replica.size()) == nodes) return;
+
+		for (size_t i = 0; i < eval_replica.size(); i++) {
+			if (eval_replica[i]) eval_retired.push_back(eval_replica[i]);
+		}
+		eval_replica.clear();
+		replica_src = NULL;
+		if (nodes <= 1) return;
+
+		eval_replica.resize(nodes);
+		ReplicaTask t = { eval_cur, &eval_replica[0] };
+		run_parallel(nodes, make_replica, &t);
+		numa_bind_self(Threads[0].numaNode);
+		replica_src = eval_cur;
+		std::cout << "info string EvalNuma " << nodes << " copies (" << eval_image_info(eval_cur) << ")" << std::endl;
+	}
+}
+#endif
+
+// T̊JnƏIBT̑SXbh͊Jn̕]xNggB
+// O̒TςĂ΁AÂ̂ŌvZ]nbV╔âĂ
+void eval_search_begin(const Position &pos)
+{
+#if !defined(EVAL_MICRO)
+	poll_eval_reload(false);
+	const EvalImage *img = eval_cur;
+	if (img != eval_last) {
+		EvalHash.clear();
+		pos.invalidate_eval();
+		eval_last = img;
+	}
+	update_eval_replicas();
+	for (int t = 0; t < MAX_THREADS; t++) {
+		const int node = Threads[t].numaNode;
+		Threads[t].evalImage = (node >= 0 && node < int(eval_replica.size()) && eval_replica[node]) ? eval_replica[node] : img;
+	}
+#else
+	(void)pos;
+#endif
+}
+
+void eval_search_end()
+{
+#if !defined(EVAL_MICRO)
+	for (int t = 0; t < MAX_THREADS; t++) Threads[t].evalImage = NULL;
+	collect_retired();
+#endif
+}
 
+// "int8, 110MB, exceptions 12345" ̂悤Ȑ
+std::string eval_image_info(const EvalImage *img)
+{
 #if !defined(EVAL_MICRO)
-  //short fv_pp[pp_bend][pp_end];
-  //short fv_kp[nsquare][kp_end];
-        short kkp[nsquare][nsquare][fe_end];
-        short ***pc_on_sq;
-        int   kk[nsquare][nsquare];
+	if (img == NULL) return "none";
+	const EvalFileHeader *h = eval_header(img);
+	char buf[128];
+	if (h->kpp_format == EVAL_KPP_INT8) {
+		snprintf(buf, sizeof(buf), "int8, %dMB, exceptions %d", int(h->file_size >> 20), int(h->exc_count));
+	} else {
+		snprintf(buf, sizeof(buf), "int16, %dMB", int(h->file_size >> 20));
+	}
+	return std::string(buf) + (img->mirror ? ", mirror" : "") + (h->perm_offset ? ", permuted" : "")
+	     + (img->mapped ? ", mmap" : "");
+#else
+	(void)img;
+	return "none";
 #endif
 }
 
-namespace NanohaTbl {
-	const short z2sq[] = {
-		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-		-1,  0,  9, 18, 27, 36, 45, 54, 63, 72, -1, -1, -1, -1, -1, -1,
-		-1,  1, 10, 19, 28, 37, 46, 55, 64, 73, -1, -1, -1, -1, -1, -1,
-		-1,  2, 11, 20, 29, 38, 47, 56, 65, 74, -1, -1, -1, -1, -1, -1,
-		-1,  3, 12, 21, 30, 39, 48, 57, 66, 75, -1, -1, -1, -1, -1, -1,
-		-1,  4, 13, 22, 31, 40, 49, 58, 67, 76, -1, -1, -1, -1, -1, -1,
-		-1,  5, 14, 23, 32, 41, 50, 59, 68, 77, -1, -1, -1, -1, -1, -1,
-		-1,  6, 15, 24, 33, 42, 51, 60, 69, 78, -1, -1, -1, -1, -1, -1,
-		-1,  7, 16, 25, 34, 43, 52, 61, 70, 79, -1, -1, -1, -1, -1, -1,
-		-1,  8, 17, 26, 35, 44, 53, 62, 71, 80, -1, -1, -1, -1, -1, -1,
-	};
+#if !defined(EVAL_MICRO)
+namespace {
+	// ]xNg output ɏBN output  mmap Ăꍇ̂ŁAʖŏĂu
+	bool write_eval_image(const EvalImage *image, const char *output)
+	{
+		const EvalFileHeader *h = eval_header(image);
+		const std::string tmp = std::string(output) + ".tmp";
+		const size_t size = size_t(h->file_size);
+		FILE *fp = fopen(tmp.c_str(), "wb");
+		bool ok = (fp != NULL && fwrite(image->image, 1, size, fp) == size);
+		if (fp && fclose(fp) != 0) ok = false;
+		if (ok) {
+			remove(output);
+			ok = (rename(tmp.c_str(), output) == 0);
+		}
+		if (!ok) remove(tmp.c_str());
+		return ok;
+	}
 }
+#endif
 
-void Position::init_evaluate()
+// fv3.bin  mmap p̌`(FV3_MAP)ɕϊ
+// fvconv [ = fv3.bin] [o = fv3map.bin] [int16 | int8 = int16] [full | mirror = full]
+// ͂ fv3.bin łϊς݂̂(FV3_MAP)ł悢Bint8  KPP ʎqA
+// mirror ͍E]lƂ̕ς̂ŁAǂɂ͖߂ȂB
+// N FV3_MAP ̃`FbNTm߂Ȃ̂ŁAĂȂ͓`ւ̕ϊŊm߂
+void convert_fv(int argc, char* argv[])
 {
-	int iret=0;
 #if !defined(EVAL_MICRO)
-	FILE *fp;
-	/*	const char *fname ="]xNg";
-
-	do {
-		size_t size;
+	const char *input  = (argc > 1) ? argv[1] : FV3_BIN;
+	const char *output = (argc > 2) ? argv[2] : FV3_MAP;
+	const std::string format = (argc > 3) ? argv[3] : "int16";
+	const std::string layout = (argc > 4) ? argv[4] : "full";
 
-		fname = FV_BIN;
-		fp = fopen(fname, "rb");
-		if ( fp == NULL ) { iret = -2; break;}
+	if (format != "int16" && format != "int8") {
+		std::cerr << "Unknown format " << format << "." << std::endl;
+		return;
+	}
+	if (layout != "full" && layout != "mirror") {
+		std::cerr << "Unknown layout " << layout << "." << std::endl;
+		return;
+	}
+	EvalImage *src = load_eval_image(input, true);
+	if (src == NULL) {
+		std::cerr << "Can't load " << input << "." << std::endl;
+		return;
+	}
+	const uint32_t kpp_format = (format == "int8") ? EVAL_KPP_INT8 : EVAL_KPP_INT16;
+	const bool mirror = (layout == "mirror");
+	EvalImage *image = src;
+	if (eval_header(src)->kpp_format != kpp_format || src->mirror != mirror) {
+		// ʂ̔ԍtւ̂́Atւ܂ܕϊ
+		image = convert_eval_image(*src, kpp_format, mirror, eval_header(src)->perm_offset ? src->fmap->perm : NULL);
+	}
 
-		size = pp_bend * pp_end;
-		if ( fread( fv_pp, sizeof(short), size, fp ) != size )
-		{
-			iret = -2;
-			break;
-		}
+	if (write_eval_image(image, output)) {
+		std::cout << input << " -> " << output << " (" << eval_image_info(image) << ", checksum "
+		          << std::hex << eval_header(image)->checksum << std::dec << ")" << std::endl;
+	} else {
+		std::cerr << "Can't write " << output << "." << std::endl;
+	}
+	if (image != src) free_eval_image(image);
+	free_eval_image(src);
+#else
+	(void)argc; (void)argv;
+	std::cerr << "fvconv is not supported." << std::endl;
+#endif
+}
 
-		size = nsquare * kp_end;
-		if ( fread( fv_kp, sizeof(short), size, fp ) != size ) {
-			iret = -2;
-			break;
+#if !defined(EVAL_MICRO)
+namespace {
+	// ʂ̈ʒu̓Y k  KPP ̑SvZœǂރLbVC̐(list ͏ɕׂĂ邱)
+	int kpp_lines(const int k, const int list[], const int nlist, const int size)
+	{
+		const size_t base = size_t(k) * pos_n;
+		int lines = 0;
+		for (int i = 1; i < nlist; i++) {
+			const size_t row = base + kpp_tri[list[i]];
+			size_t last = ~size_t(0);
+			for (int j = 0; j < i; j++) {
+				const size_t line = (row + list[j]) * size / 64;
+				if (line != last) lines++;
+				last = line;
+			}
 		}
+		return lines;
+	}
 
-		if (fgetc(fp) != EOF) {
-			iret = -2;
-			break;
+	// ǖʂ̏W܂ł̓ʂ̑g̏oA悭ꏏɌʂ߂ԍɂȂ悤ɕtւB
+	// ȏ̂n߁A܂łɕׂ̂ƈꏏɌꂽ񐔂ԑ̂ɕׂB
+	// KPP ͔ԍ̑傫̍s̒ň̂ŁA悭ggOp̑O̕Ɍł܂
+	void make_feature_perm(const std::vector<uint32_t> &cooc, const std::vector<uint64_t> &freq, uint16_t perm[fe_end])
+	{
+		std::vector<uint64_t> score(fe_end);
+		std::vector<bool> placed(fe_end);
+		for (int n = 0; n < fe_end; n++) {
+			int best = -1;
+			for (int f = 0; f < fe_end; f++) {
+				if (placed[f]) continue;
+				if (best < 0 || score[f] > score[best] || (score[f] == score[best] && freq[f] > freq[best])) best = f;
+			}
+			placed[best] = true;
+			perm[best] = uint16_t(n);
+			for (int f = 0; f < fe_end; f++) score[f] += cooc[size_t(best) * fe_end + f];
 		}
-	} while (0);
-	if (fp) fclose( fp );
-	*/do {
-		size_t size;
+	}
+}
+#endif
 
-		//fname = "fv3.bin";
-		fp = fopen("fv3.bin", "rb");
-		if ( fp == NULL ) { iret = -2; break;}
+// ǖʂ̏W܂(SFEN 1s1ǖ)ʂ̔ԍ̕tւA]xNg̏ɕבւďB
+// `(int16/int8, mirror)͓͂̂܂܁BN EvalFile œǂނƁAtւꏏɓǂݍ܂
+// fvperm [SFEN t@C] [ = fv3map.bin] [o = fv3perm.bin]
+void permute_fv(int argc, char* argv[])
+{
+#if !defined(EVAL_MICRO)
+	if (argc < 2) {
+		std::cerr << "Usage: fvperm [sfen file] [input = " FV3_MAP "] [output = fv3perm.bin]" << std::endl;
+		return;
+	}
+	const char *input  = (argc > 2) ? argv[2] : FV3_MAP;
+	const char *output = (argc > 3) ? argv[3] : "fv3perm.bin";
+	std::ifstream in(argv[1]);
+	if (!in.is_open()) {
+		std::cerr << "Unable to open file " << argv[1] << std::endl;
+		return;
+	}
+	EvalImage *src = load_eval_image(input, true);
+	if (src == NULL) {
+		std::cerr << "Can't load " << input << "." << std::endl;
+		return;
+	}
 
-		pc_on_sq = (short***)malloc( nsquare * sizeof(short**) );
-		if( !pc_on_sq ){
-		  iret = -2; break;
-		}
-		for( int i=0; i<nsquare; ++i ){
-		  pc_on_sq[i] = (short**)malloc( fe_end * sizeof( short *) );
-		  if( !pc_on_sq[i] ){
-		    iret = -2; break;
-		  }
-		  for( int j=0; j<fe_end; ++j ){
-		    pc_on_sq[i][j] = (short*)malloc( fe_end * sizeof( short ) );
-		    if( !pc_on_sq[i][j] ){
-		      iret = -2; break;
-		    }
-		  }
-		}
-		size = fe_end ;
-		for( int i=0; i<nsquare; ++i ){
-		  for( int j=0; j<fe_end; ++j ){
-		    if ( fread( pc_on_sq[i][j], sizeof(short), size, fp ) != size ) {
-			iret = -2;
-			break;
-		    }
-		  }
+	// make_list() ̔ԍ͕]ɎgĂ(eval_cur)Ȃ̂ŁAtւO̔ԍɖ߂Đ
+	const int SAMPLE = 100000;		// ǂރLbVCׂǖʂ̐
+	const EvalImage::FeatureMap &cur = *eval_cur->fmap;
+	std::vector<uint32_t> cooc(size_t(fe_end) * fe_end);
+	std::vector<uint64_t> freq(fe_end);
+	std::vector<int> sample;		// ʂ̈ʒu̓Y, ʂ̐, ... ̌JԂ
+	std::string fen;
+	int positions = 0;
+	while (getline(in, fen)) {
+		if (fen.empty()) continue;
+		if (fen.compare(0, 5, "sfen ") == 0) fen.erase(0, 5);
+		Position pos(fen, 0);
+		EvalFeatures f;
+		pos.make_eval_features(f);
+		for (int side = 0; side < 2; side++) {
+			const int *list = side ? f.list1 : f.list0;
+			const int sq = side ? Inv(f.sq_wk) : f.sq_bk;
+			bool left;
+			const int k = king_index(*src, sq, left);
+			int raw[NLIST];
+			for (int i = 0; i < f.nlist; i++) {
+				raw[i] = cur.inv[list[i]];
+				if (left) raw[i] = mirror_fe[raw[i]];
+				freq[raw[i]]++;
+				for (int j = 0; j < i; j++) {
+					cooc[size_t(raw[i]) * fe_end + raw[j]]++;
+					cooc[size_t(raw[j]) * fe_end + raw[i]]++;
+				}
+			}
+			if (positions < SAMPLE) {
+				sample.push_back(k);
+				sample.push_back(f.nlist);
+				sample.insert(sample.end(), raw, raw + f.nlist);
+			}
 		}
+		positions++;
+	}
+	if (positions == 0) {
+		std::cerr << "No positions in " << argv[1] << "." << std::endl;
+		free_eval_image(src);
+		return;
+	}
 
-		size = nsquare * nsquare * fe_end;
-		if ( fread( kkp, sizeof(short), size, fp ) != size )
-		{
-			iret = -2;
-			break;
-		}
-		size = nsquare * nsquare;
-		if ( fread( kk, sizeof(int), size, fp ) != size )
-		{
-			iret = -2;
-			break;
-		}
+	uint16_t perm[fe_end];
+	make_feature_perm(cooc, freq, perm);
 
-		if (fgetc(fp) != EOF) {
-			iret = -2;
-			break;
+	// tւOƌŁAKPP ̑SvZœǂރLbVCׂ̐
+	const int size = src->kpp ? int(sizeof(short)) : int(sizeof(int8_t));
+	int64_t lines[2] = { 0, 0 };
+	int nsample = 0;
+	for (size_t p = 0; p < sample.size(); p += 2 + sample[p + 1], nsample++) {
+		const int k = sample[p], n = sample[p + 1];
+		int list[NLIST];
+		for (int t = 0; t < 2; t++) {
+			for (int i = 0; i < n; i++) list[i] = t ? perm[sample[p + 2 + i]] : src->fmap->perm[sample[p + 2 + i]];
+			std::sort(list, list + n);
+			lines[t] += kpp_lines(k, list, n, size);
 		}
-	} while (0);
-	if (fp) fclose( fp );
+	}
+	nsample /= 2;
 
-	if (iret < 0) {
-#if !defined(NDEBUG)
-		std::cerr << "Can't load " FV_BIN "." << std::endl;
-#endif
-#if defined(CSADLL) || defined(CSA_DIRECT)
-		::MessageBox(NULL, "]xNg[hł܂\nI܂", "Error!", MB_OK);
-		exit(1);
-#endif	// defined(CSA_DLL) || defined(CSA_DIRECT)
+	const EvalFileHeader *h = eval_header(src);
+	EvalImage *image = convert_eval_image(*src, h->kpp_format, src->mirror, perm);
+	std::cout << positions << " positions, KPP cache lines per position " << lines[0] / nsample
+	          << " -> " << lines[1] / nsample << std::endl;
+	if (write_eval_image(image, output)) {
+		std::cout << input << " -> " << output << " (" << eval_image_info(image) << ", checksum "
+		          << std::hex << eval_header(image)->checksum << std::dec << ")" << std::endl;
+	} else {
+		std::cerr << "Can't write " << output << "." << std::endl;
 	}
+	free_eval_image(image);
+	free_eval_image(src);
+#else
+	(void)argc; (void)argv;
+	std::cerr << "fvperm is not supported." << std::endl;
 #endif
-
-	for (int i = 0; i < 31; i++) { p_value[i]       = 0; }
-
-	p_value[15+pawn]       = DPawn;
-	p_value[15+lance]      = DLance;
-	p_value[15+knight]     = DKnight;
-	p_value[15+silver]     = DSilver;
-	p_value[15+gold]       = DGold;
-	p_value[15+bishop]     = DBishop;
-	p_value[15+rook]       = DRook;
-	p_value[15+king]       = DKing;
-	p_value[15+pro_pawn]   = DProPawn;
-	p_value[15+pro_lance]  = DProLance;
-	p_value[15+pro_knight] = DProKnight;
-	p_value[15+pro_silver] = DProSilver;
-	p_value[15+horse]      = DHorse;
-	p_value[15+dragon]     = DDragon;
-
-	p_value[15-pawn]          = p_value[15+pawn];
-	p_value[15-lance]         = p_value[15+lance];
-	p_value[15-knight]        = p_value[15+knight];
-	p_value[15-silver]        = p_value[15+silver];
-	p_value[15-gold]          = p_value[15+gold];
-	p_value[15-bishop]        = p_value[15+bishop];
-	p_value[15-rook]          = p_value[15+rook];
-	p_value[15-king]          = p_value[15+king];
-	p_value[15-pro_pawn]      = p_value[15+pro_pawn];
-	p_value[15-pro_lance]     = p_value[15+pro_lance];
-	p_value[15-pro_knight]    = p_value[15+pro_knight];
-	p_value[15-pro_silver]    = p_value[15+pro_silver];
-	p_value[15-horse]         = p_value[15+horse];
-	p_value[15-dragon]        = p_value[15+dragon];
 }
 
 int Position::compute_material() const
@@ -424,7 +1970,38 @@ int Position::compute_material() const
 }
 
 #if !defined(EVAL_MICRO)
-int Position::make_list(int * pscore, int list0[NLIST], int list1[NLIST] ) const
+// ʂ̃XgB Hand::h AՏ̋͋ԍƂ̈ʒu(knpos)
+// (knkind)\Bʂ̓ʂ͖Bԍ͕]Ɏg]xNĝ
+int Position::make_list(int * /*pscore*/, int list0[NLIST], int list1[NLIST] ) const
+{
+	const EvalImage::FeatureMap &m = *eval_table(threadID).fmap;
+	int nlist = 0;
+
+	// (0̓ʂ͎Ȃ)
+	for (int pt = FU; pt <= HI; pt++) {
+		for (int c = BLACK; c <= WHITE; c++) {
+			const int n = int((hand[c].h & hand_mask[pt]) >> hand_shift[pt]);
+			if (n > 0) {
+				list0[nlist  ] = m.hand_list[c][pt][n].l0;
+				list1[nlist++] = m.hand_list[c][pt][n].l1;
+			}
+		}
+	}
+
+	// Տ̋
+	for (int kn = KNS_HI; kn <= KNE_FU; kn++) {
+		const int z = knpos[kn];
+		if (IsHand(z)) continue;	// gp
+		const EvalImage::ListIndex &li = m.kp_list[knkind[kn]][z];
+		list0[nlist  ] = li.l0;
+		list1[nlist++] = li.l1;
+	}
+	assert( nlist <= NLIST );
+	return nlist;
+}
+
+// Ֆʂ𑖍ȑO make_list()Bbench eval ŕ\̂̂Ɣׂ
+int Position::make_list_scan(int * pscore, int list0[NLIST], int list1[NLIST] ) const
 {
   int sq, /*i,*/ score /*, sq_bk0, sq_bk1*/;
 
@@ -932,104 +2509,345 @@ int Position::make_list(int * pscore, int list0[NLIST], int list1[NLIST] ) const
 	*/
 	assert( nlist <= NLIST );
 
+	// ԍtւ]xNgȂAɍ킹
+	const EvalImage::FeatureMap *m = eval_table(threadID).fmap;
+	if (m != &identity_map) {
+		for (int i = 0; i < nlist; i++) {
+			list0[i] = m->perm[list0[i]];
+			list1[i] = m->perm[list1[i]];
+		}
+	}
+
 	*pscore += score; // 0
 	return nlist;
 }
 #endif
 
-int Position::evaluate(const Color us) const
-{
 #if !defined(EVAL_MICRO)
+// wőʂ st->evalDiff ɋL^(ՖʂƎXVɌĂ)
+//   before : ړŐ(ł̂Ƃ͑ł)
+//   from   : ړ(ł̂Ƃ0)
+//   after  : ړ̋
+//   capture: (ȂEMP)
+void Position::set_eval_diff(const Piece before, const int from, const Piece after, const int to, const Piece capture)
+{
+	EvalDiff &d = st->evalDiff;
+
+	st->evalValid = false;
+	st->kingMoved = (after == SOU || after == GOU);
+	d.nRemoved = d.nAdded = 0;
+	if (st->kingMoved) return;		// ʂƂ͑SvZ
+
+	const EvalImage::FeatureMap &m = *eval_table(threadID).fmap;
+	const Color us = color_of(after);
+	int pt;
+
+	d.added[0][0] = m.kp_list[after][to].l0;
+	d.added[0][1] = m.kp_list[after][to].l1;
+	d.nAdded = 1;
+	if (from) {
+		d.removed[0][0] = m.kp_list[before][from].l0;
+		d.removed[0][1] = m.kp_list[before][from].l1;
+		d.nRemoved = 1;
+		if (capture == EMP) return;
+
+		d.removed[1][0] = m.kp_list[capture][to].l0;
+		d.removed[1][1] = m.kp_list[capture][to].l1;
+		d.nRemoved = 2;
+		pt = capture & ~(GOTE | PROMOTED);
+	} else {
+		pt = after & ~GOTE;
+	}
+
+	// ̖ς
+	const int n = int((hand[us].h & hand_mask[pt]) >> hand_shift[pt]);
+	const int n0 = from ? n - 1 : n + 1;
+	if (n0 > 0) {
+		d.removed[d.nRemoved][0] = m.hand_list[us][pt][n0].l0;
+		d.removed[d.nRemoved][1] = m.hand_list[us][pt][n0].l1;
+		d.nRemoved++;
+	}
+	if (n > 0) {
+		d.added[d.nAdded][0] = m.hand_list[us][pt][n].l0;
+		d.added[d.nAdded][1] = m.hand_list[us][pt][n].l1;
+		d.nAdded++;
+	}
+}
+
+// KK, KKP, KPP SvZ st->evalSum ɕۑ
+void Position::calc_eval_full() const
+{
+	FullEval fe;
+	int score = 0;
+	const EvalImage &e = eval_table(threadID);
+
+	fe.nlist = make_list( &score, fe.list0, fe.list1 );
+	fe.prepare( e, SQ_BKING, SQ_WKING );
+	fe.sum( e, st->evalSum );
+	st->evalSum[2] += score;
+	st->evalValid = true;
+}
+
+// vZς݂̋ǖ base  evalSum ɁA猻ǖʂ܂ł evalDiff ̕B
+void Position::calc_eval_diff(const StateInfo *base) const
+{
+	const StateInfo *p;
+	const StateInfo *path[EVAL_DIFF_PLY];
+	short add[EVAL_DIFF_PLY*3][2], rem[EVAL_DIFF_PLY*3][2];
+	int nAdd = 0, nRem = 0, nPath = 0;
 	int list0[NLIST], list1[NLIST];
-	int nlist, score, sq_bk, sq_wk, k0, k1, l0, l1, i, j, sum;
-	static int count=0;
-	count++;
+	int nlist, score, k0, k1, i, j, n;
+	const int sq_bk = SQ_BKING;
+	const int sq_wk = Inv( SQ_WKING );
+	int sum0 = base->evalSum[0];
+	int sum1 = base->evalSum[1];
+	int sum2 = base->evalSum[2];
+	const EvalImage &e = eval_table(threadID);
+	bool m0, m1;
+	const int kb = king_index( e, sq_bk, m0 );
+	const int kw = king_index( e, sq_wk, m1 );
+	const int wk = m0 ? mirror_sq[SQ_WKING] : SQ_WKING;
 
-	sum = 0;
-	sq_bk = SQ_BKING;
-	sq_wk = Inv( SQ_WKING );
-/*
-	sum += fv_kp[sq_bk][kp_hand_bpawn   + I2HandPawn(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wpawn   + I2HandPawn(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_bpawn   + I2HandPawn(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wpawn   + I2HandPawn(HAND_B)];
-
-	sum += fv_kp[sq_bk][kp_hand_blance  + I2HandLance(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wlance  + I2HandLance(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_blance  + I2HandLance(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wlance  + I2HandLance(HAND_B)];
-
-	sum += fv_kp[sq_bk][kp_hand_bknight + I2HandKnight(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wknight + I2HandKnight(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_bknight + I2HandKnight(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wknight + I2HandKnight(HAND_B)];
-
-	sum += fv_kp[sq_bk][kp_hand_bsilver + I2HandSilver(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wsilver + I2HandSilver(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_bsilver + I2HandSilver(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wsilver + I2HandSilver(HAND_B)];
-
-	sum += fv_kp[sq_bk][kp_hand_bgold   + I2HandGold(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wgold   + I2HandGold(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_bgold   + I2HandGold(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wgold   + I2HandGold(HAND_B)];
-
-	sum += fv_kp[sq_bk][kp_hand_bbishop + I2HandBishop(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wbishop + I2HandBishop(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_bbishop + I2HandBishop(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wbishop + I2HandBishop(HAND_B)];
-
-	sum += fv_kp[sq_bk][kp_hand_brook   + I2HandRook(HAND_B)];
-	sum += fv_kp[sq_bk][kp_hand_wrook   + I2HandRook(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_brook   + I2HandRook(HAND_W)];
-	sum -= fv_kp[sq_wk][kp_hand_wrook   + I2HandRook(HAND_B)];
-	
-	*/
-	score = 0;
-	nlist = make_list( &score, list0, list1 );
-	/*
-	for ( i = 0; list0[i] < pp_bend; i++ )
+	// base 猻ǖʂ܂łɑʂ܂Ƃ߂(rőď̂͑E)
+	for ( p = st; p != base; p = p->previous ) path[nPath++] = p;
+	while ( nPath > 0 )
 	{
-		assert(i < nlist);
-		k0 = list0[i];
-		for ( j = i+1; j < nlist; j++ )
+		const EvalDiff &d = path[--nPath]->evalDiff;
+		for ( i = 0; i < d.nRemoved; i++ )
 		{
-			l0 = list0[j];
-			sum += PcPcOn( k0, l0 );
-			//sum += PcPcOnSq( sq_bk, k0, l0);
+			for ( j = 0; j < nAdd && add[j][0] != d.removed[i][0]; j++ ) ;
+			if ( j < nAdd ) {
+				nAdd--;
+				add[j][0] = add[nAdd][0];
+				add[j][1] = add[nAdd][1];
+			} else {
+				rem[nRem][0] = d.removed[i][0];
+				rem[nRem][1] = d.removed[i][1];
+				nRem++;
+			}
+		}
+		for ( i = 0; i < d.nAdded; i++ )
+		{
+			for ( j = 0; j < nRem && rem[j][0] != d.added[i][0]; j++ ) ;
+			if ( j < nRem ) {
+				nRem--;
+				rem[j][0] = rem[nRem][0];
+				rem[j][1] = rem[nRem][1];
+			} else {
+				add[nAdd][0] = d.added[i][0];
+				add[nAdd][1] = d.added[i][1];
+				nAdd++;
+			}
 		}
 	}
-	
-	for ( ; i < nlist; i++ )
+
+	// E]Ď\Ƃ́Aʂ 1-4؂ɂ鑤̓ʂ𔽓]
+	const short *mfe = e.fmap->mirror_fe;
+	for ( i = 0; m0 && i < nAdd; i++ ) add[i][0] = mfe[add[i][0]];
+	for ( i = 0; m0 && i < nRem; i++ ) rem[i][0] = mfe[rem[i][0]];
+	for ( i = 0; m1 && i < nAdd; i++ ) add[i][1] = mfe[add[i][1]];
+	for ( i = 0; m1 && i < nRem; i++ ) rem[i][1] = mfe[rem[i][1]];
+
+	// ʂ KKP ƁA瓯m KPP
+	for ( i = 0; i < nAdd; i++ )
 	{
-		k1 = list1[i];
-		assert(k1 < pp_bend);
-		for ( j = i+1; j < nlist; j++ )
+		sum2 += e.kkp[kb][wk][ add[i][0] ];
+		for ( j = 0; j < i; j++ )
 		{
-			l1 = list1[j];
-			sum -= PcPcOn( k1, l1 );
-			//sum -= PcPcOnSq( sq_wk, k1, l1 );
+			sum0 += PcPcOnSq( kb, add[i][0], add[j][0] );
+			sum1 += PcPcOnSq( kw, add[i][1], add[j][1] );
 		}
 	}
-*/
-	for ( i = 0; i < nlist; i++ )
+	for ( i = 0; i < nRem; i++ )
 	{
-		assert(i < nlist);
-		k0 = list0[i];
-		k1 = list1[i];
-		sum += kkp[sq_bk][SQ_WKING][ k0 ];
+		sum2 -= e.kkp[kb][wk][ rem[i][0] ];
 		for ( j = 0; j < i; j++ )
 		{
-			l0 = list0[j];
-			l1 = list1[j];
-			//sum += PcPcOnSq( sq_bk, k0, l0 );
-			//sum -= PcPcOnSq( sq_wk, k1, l1 );
-			sum += pc_on_sq[ sq_bk ][k0][l0];
-			sum -= pc_on_sq[ sq_wk ][k1][l1];
+			sum0 -= PcPcOnSq( kb, rem[i][0], rem[j][0] );
+			sum1 -= PcPcOnSq( kw, rem[i][1], rem[j][1] );
+		}
+	}
+
+	// ωȂʂƂ KPP
+	score = 0;
+	nlist = make_list( &score, list0, list1 );
+	if ( m0 ) mirror_list( e, list0, nlist );
+	if ( m1 ) mirror_list( e, list1, nlist );
+	for ( n = 0; n < nlist; n++ )
+	{
+		k0 = list0[n];
+		k1 = list1[n];
+		for ( j = 0; j < nAdd && add[j][0] != k0; j++ ) ;
+		if ( j < nAdd ) continue;
+
+		for ( j = 0; j < nAdd; j++ )
+		{
+			sum0 += PcPcOnSq( kb, add[j][0], k0 );
+			sum1 += PcPcOnSq( kw, add[j][1], k1 );
+		}
+		for ( j = 0; j < nRem; j++ )
+		{
+			sum0 -= PcPcOnSq( kb, rem[j][0], k0 );
+			sum1 -= PcPcOnSq( kw, rem[j][1], k1 );
+		}
+	}
+
+	st->evalSum[0] = sum0;
+	st->evalSum[1] = sum1;
+	st->evalSum[2] = sum2;
+	st->evalValid = true;
+}
+#endif
+
+void Position::make_eval_features(EvalFeatures &f) const
+{
+	f.us = side_to_move();
+	f.material = MATERIAL;
+	f.score = 0;
+#if !defined(EVAL_MICRO)
+	f.sq_bk = SQ_BKING;
+	f.sq_wk = SQ_WKING;
+	f.nlist = make_list( &f.score, f.list0, f.list1 );
+#else
+	f.sq_bk = f.sq_wk = 0;
+	f.nlist = 0;
+#endif
+}
+
+// ǖʂ܂Ƃ߂ĕ]Bahead ǖʐ̕\ǂ݂Ȃ珇ɑĂ̂ŁA
+// 1ǖʂ evaluate() \ǂޑ҂dȂ
+void evaluate_batch(const EvalFeatures f[], int n, Value values[], int ahead)
+{
+#if !defined(EVAL_MICRO)
+	const int RING = 16;
+	const EvalImage &e = *eval_cur;
+	FullEval fe[RING];
+	int i, s[3];
+
+	ahead = std::max(0, std::min(ahead, RING - 1));
+	for (i = 0; i < n + ahead; i++) {
+		if (i < n) {
+			FullEval &p = fe[i % RING];
+			p.nlist = f[i].nlist;
+			memcpy(p.list0, f[i].list0, f[i].nlist * sizeof(int));
+			memcpy(p.list1, f[i].list1, f[i].nlist * sizeof(int));
+			p.prepare(e, f[i].sq_bk, f[i].sq_wk);
+			if (ahead > 0) p.prefetch(e);
+		}
+		const int k = i - ahead;
+		if (k < 0) continue;
+		fe[k % RING].sum(e, s);
+		int score = (s[0] - s[1] + s[2] + f[k].score) / FV_SCALE + f[k].material;
+		values[k] = Value((f[k].us == BLACK) ? score : -score);
+	}
+#else
+	for (int i = 0; i < n; i++) values[i] = Value((f[i].us == BLACK) ? f[i].material : -f[i].material);
+	(void)ahead;
+#endif
+}
+
+void evaluate_batch(const Position *const pos[], int n, Value values[])
+{
+	const int CHUNK = 256;
+	std::vector<EvalFeatures> f(std::min(n, CHUNK));
+	for (int i = 0; i < n; i += CHUNK) {
+		const int m = std::min(n - i, CHUNK);
+		for (int j = 0; j < m; j++) pos[i + j]->make_eval_features(f[j]);
+		evaluate_batch(&f[0], m, values + i);
+	}
+}
+
+const char *eval_part_name(EvalPart part)
+{
+	static const char *const name[EVAL_PART_NB] = { "make_list", "prepare", "kk_kkp", "kpp" };
+	return name[part];
+}
+
+#if !defined(EVAL_MICRO)
+namespace {
+	// eval_profile_part() ̓ř
+	struct ProfileEval {
+		EvalFeatures f;
+		FullEval fe;
+		int s[3];
+	};
+	std::vector<ProfileEval> profile;
+}
+#endif
+
+void eval_profile_part(EvalPart part, const Position *const pos[], int n, Value values[])
+{
+#if !defined(EVAL_MICRO)
+	const EvalImage &e = *eval_cur;
+	int i;
+
+	if ((int)profile.size() < n) profile.resize(n);
+	switch (part) {
+	case EVAL_PART_LIST:
+		for (i = 0; i < n; i++) pos[i]->make_eval_features(profile[i].f);
+		break;
+	case EVAL_PART_PREPARE:
+		for (i = 0; i < n; i++) {
+			ProfileEval &p = profile[i];
+			p.fe.nlist = p.f.nlist;
+			memcpy(p.fe.list0, p.f.list0, p.f.nlist * sizeof(int));
+			memcpy(p.fe.list1, p.f.list1, p.f.nlist * sizeof(int));
+			p.fe.prepare(e, p.f.sq_bk, p.f.sq_wk);
+		}
+		break;
+	case EVAL_PART_KKP:
+		for (i = 0; i < n; i++) profile[i].s[2] = profile[i].fe.sum_kkp(e);
+		break;
+	case EVAL_PART_KPP:
+		for (i = 0; i < n; i++) {
+			ProfileEval &p = profile[i];
+			p.fe.sum_kpp(e, p.s[0], p.s[1]);
+			const int score = (p.s[0] - p.s[1] + p.s[2] + p.f.score) / FV_SCALE + p.f.material;
+			values[i] = Value((p.f.us == BLACK) ? score : -score);
+		}
+		break;
+	default:
+		break;
+	}
+#else
+	if (part == EVAL_PART_KPP) evaluate_batch(pos, n, values);
+#endif
+}
+
+int Position::evaluate(const Color us) const
+{
+#if !defined(EVAL_MICRO)
+	int score;
+
+	if ( !st->evalValid )
+	{
+		// ]nbVɕa΂g
+		Thread &th = Threads[threadID];
+		const Key k = st->key;
+		th.evalHashProbes++;
+		if ( EvalHash.probe( k, st->evalSum ) )
+		{
+			th.evalHashHits++;
+			st->evalValid = true;
+		}
+		else
+		{
+			// EVAL_DIFF_PLY O܂łɌvZς݂̋ǖʂÅԂɋʂĂȂ΍vZ
+			const StateInfo *p = st;
+			int ply = 0;
+			while ( !p->evalValid && !p->kingMoved && p->previous && ply < EVAL_DIFF_PLY )
+			{
+				p = p->previous;
+				ply++;
+			}
+			if ( p != st && p->evalValid )
+				calc_eval_diff(p);
+			else
+				calc_eval_full();
+			EvalHash.store( k, st->evalSum );
 		}
 	}
-	sum += kk[sq_bk][SQ_WKING];
-	score += sum;
+	score = st->evalSum[0] - st->evalSum[1] + st->evalSum[2];
 	score /= FV_SCALE;
 
 	score += MATERIAL;
@@ -1042,6 +2860,13 @@ int Position::evaluate(const Color us) const
 #endif
 }
 
+// ]xNgւƂɁAǖʂɎcĂ镔âĂ
+void Position::invalidate_eval() const
+{
+	for (StateInfo *p = st; p != NULL; p = p->previous) p->evalValid = false;
+}
+
+// margin ͕]ľ덷̕BSvZlԂ̂ŏ 0
 Value evaluate(const Position& pos, Value& margin)
 {
 	margin = VALUE_ZERO;
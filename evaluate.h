@@ -21,10 +21,73 @@
 #if !defined(EVALUATE_H_INCLUDED)
 #define EVALUATE_H_INCLUDED
 
+#include <string>
+
 #include "types.h"
 
 class Position;
 
 Value evaluate(const Position& pos, Value& margin);
 
+#if defined(NANOHA)
+// SvZ(Position::calc_eval_full) KPP ̘a镔̎
+enum EvalKernel {
+	EVAL_KERNEL_SCALAR,
+	EVAL_KERNEL_SSE41,
+	EVAL_KERNEL_AVX2,
+	EVAL_KERNEL_NB
+};
+
+bool eval_kernel_supported(EvalKernel k);
+bool set_eval_kernel(EvalKernel k);		// s CPU ŎgȂ false
+EvalKernel get_eval_kernel();
+const char *eval_kernel_name(EvalKernel k);
+
+// ]xNgꎮ(KPP  int16 ̂̂ int8 ̂̂)
+struct EvalImage;
+
+EvalImage *load_eval_image(const char *fname, bool verify = false);	// fv3.bin  fvconv ŕΐBǂ߂Ȃ NULL
+EvalImage *set_eval_image(EvalImage *img);		// ]Ɏĝ؂ւAÔ̂Ԃ
+EvalImage *get_eval_image();
+void release_eval_image(EvalImage *img);		// ]ɎgĂȂ̂
+std::string eval_image_info(const EvalImage *img);
+
+// setoption EvalFile / evalreload ŁAT~߂ɕ]xNgւ
+bool start_eval_reload(const std::string &fname, bool force);
+void poll_eval_reload(bool wait);
+void eval_search_begin(const Position &pos);
+void eval_search_end();
+
+// ǖʂ܂Ƃ߂ĕ](evaluate_batch)Ƃ1ǖʕBPosition::make_eval_features() ō
+#define NLIST	52
+struct EvalFeatures {
+	Color us;					// 
+	int material;				// 肩猩
+	int score;					// make_list() ̕
+	int sq_bk, sq_wk;			// , ʂ̈ʒu
+	int nlist;
+	int list0[NLIST], list1[NLIST];
+};
+
+const int EVAL_BATCH_AHEAD = 4;		// ǖʐ̕\ǂ݂邩(ő 15)
+
+// ԑ猩]l values ɕԂB]nbV StateInfo ̕a͎gȂ
+void evaluate_batch(const EvalFeatures f[], int n, Value values[], int ahead = EVAL_BATCH_AHEAD);
+void evaluate_batch(const Position *const pos[], int n, Value values[]);
+
+// bench evalprof őSvZ𕔕ƂɑBǖʂ܂Ƃ߂āAƂɏɍs
+enum EvalPart {
+	EVAL_PART_LIST,			// make_list()
+	EVAL_PART_PREPARE,		// ʂ̍E]ƕבւ
+	EVAL_PART_KKP,			// KK + KKP ̘a
+	EVAL_PART_KPP,			// KPP ̎Op̘a
+	EVAL_PART_NB
+};
+
+const char *eval_part_name(EvalPart part);
+// pos[0..n-1] ɂ part ̕sBřʂ͒Ɏ̂ EVAL_PART_LIST 珇ɌĂԂƁB
+// EVAL_PART_KPP ܂ŏI values Ɏԑ猩]l
+void eval_profile_part(EvalPart part, const Position *const pos[], int n, Value values[]);
+#endif
+
 #endif // !defined(EVALUATE_H_INCLUDED)
@@ -39,7 +39,15 @@ extern void benchmark(int argc, char* argv[]);
 #if defined(NANOHA)
 extern void bench_mate(int argc, char* argv[]);
 extern void bench_genmove(int argc, char* argv[]);
+extern void bench_effect(int argc, char* argv[]);
 extern void bench_eval(int argc, char* argv[]);
+extern void bench_evalcmp(int argc, char* argv[]);
+extern void bench_evalbatch(int argc, char* argv[]);
+extern void bench_evalprof(int argc, char* argv[]);
+extern void eval_file(int argc, char* argv[]);
+extern void convert_fv(int argc, char* argv[]);
+extern void permute_fv(int argc, char* argv[]);
+extern void convert_positions(int argc, char* argv[]);
 extern void solve_problem(int argc, char* argv[]);
 extern void test_qsearch(int argc, char* argv[]);
 extern void test_see(int argc, char* argv[]);
@@ -69,6 +77,11 @@ int main(int argc, char* argv[]) {
 #endif
 	init_search();
 	Threads.init();
+#if defined(NANOHA)
+	// USI ̂Ƃ isready ܂œǂݍ݂҂Ȃ
+	if (argc >= 2)
+		wait_application_init();
+#endif
 
 	if (argc < 2)
 	{
@@ -93,9 +106,24 @@ int main(int argc, char* argv[]) {
 	else if (string(argv[1]) == "bench" && argc > 2 && string(argv[2]) == "genmove") {
 		bench_genmove(--argc, ++argv);
 	}
+	else if (string(argv[1]) == "bench" && argc > 2 && string(argv[2]) == "effect") {
+		bench_effect(--argc, ++argv);
+	}
 	else if (string(argv[1]) == "bench" && argc > 2 && string(argv[2]) == "eval") {
 		bench_eval(--argc, ++argv);
 	}
+	else if (string(argv[1]) == "bench" && argc > 2 && string(argv[2]) == "evalcmp") {
+		bench_evalcmp(--argc, ++argv);
+	}
+	else if (string(argv[1]) == "bench" && argc > 2 && string(argv[2]) == "evalbatch") {
+		bench_evalbatch(--argc, ++argv);
+	}
+	else if (string(argv[1]) == "bench" && argc > 2 && string(argv[2]) == "evalprof") {
+		bench_evalprof(--argc, ++argv);
+	}
+	else if (string(argv[1]) == "evalfile") {
+		eval_file(--argc, ++argv);
+	}
 	else if (string(argv[1]) == "qsearch") {
 		test_qsearch(--argc, ++argv);
 	}
@@ -105,8 +133,17 @@ int main(int argc, char* argv[]) {
 	else if (string(argv[1]) == "problem") {
 		solve_problem(--argc, ++argv);
 	}
+	else if (string(argv[1]) == "fvconv") {
+		convert_fv(--argc, ++argv);
+	}
+	else if (string(argv[1]) == "fvperm") {
+		permute_fv(--argc, ++argv);
+	}
+	else if (string(argv[1]) == "posconv") {
+		convert_positions(--argc, ++argv);
+	}
 #endif
-	else if (string(argv[1]) == "bench" && argc < 8)
+	else if (string(argv[1]) == "bench" && argc < 9)
 		benchmark(argc, argv);
 	else
 #if defined(NANOHA)
@@ -115,7 +152,8 @@ int main(int argc, char* argv[]) {
 		cout << "Options:\n"
 		        "   bench [hash size = 128] [threads = 1] "
 		                 "[limit = 12] [fen positions file = default] "
-		                 "[limited by depth, time, nodes or perft = depth]\n";
+		                 "[limited by depth, time, nodes or perft = depth] "
+		                 "[eval numa = off]\n";
 		cout << "   bench genmove "
 		                 "[fen positions file = default] "
 		                 "[display moves = no]\n";
@@ -124,7 +162,19 @@ int main(int argc, char* argv[]) {
 		                 "[loop = yes] [display = no]\n";
 		cout << "   bench mate3 "
 		                 "[fen positions file = default] "
-		                 "[loop = yes] [display moves = no]" << endl;
+		                 "[loop = yes] [display moves = no]\n";
+		cout << "   bench evalcmp "
+		                 "[table A = fv3.bin] [table B = fv3map.bin] [depth = 7]\n";
+		cout << "   bench evalbatch "
+		                 "[fen positions file = default]\n";
+		cout << "   bench evalprof "
+		                 "[sfen file] [output file = stdout]\n";
+		cout << "   evalfile "
+		                 "[sfen file] [output file = stdout]\n";
+		cout << "   fvconv "
+		                 "[input = fv3.bin] [output = fv3map.bin] [int16 | int8 = int16]\n";
+		cout << "   fvperm "
+		                 "[sfen file] [input = fv3map.bin] [output = fv3perm.bin]" << endl;
 	}
 #else
 	cout << "Usage: stockfish bench [hash size = 128] [threads = 1] "
@@ -132,6 +182,10 @@ int main(int argc, char* argv[]) {
 	     << "[limited by depth, time, nodes or perft = depth]" << endl;
 #endif
 
+#if defined(NANOHA)
+	wait_application_init();
+#endif
 	Threads.exit();
+	Position::release_evaluate();
 	return 0;
 }
@@ -24,6 +24,7 @@
 #include <cstring>
 #include "position.h"
 #include "movegen.h"
+#include "thread.h"
 
 // VKߓ_ŌŒ[̒T𕹗pdf-pnASY gpw05.pdf
 //  qmK cNN RaI 썇d
@@ -2209,7 +2210,7 @@ int Position::Mate1ply(Move &m, uint32_t &info)
 		ret = CheckMate1plyMove<us>(info, m);
 		if (ret != 0) {
 			assert(is_ok(m));
-			COUNT_PERFORM(count_Mate1plyMove);
+			COUNT_PERFORM(Threads[threadID].mate1plyMoves);
 			CHK_MATE1PLY(m);
 			return VALUE_MATE;
 		}
@@ -2218,7 +2219,7 @@ int Position::Mate1ply(Move &m, uint32_t &info)
 		ret = CheckMate1plyDrop<us>(info, m);
 		if (ret != 0) {
 			assert(is_ok(m));
-			COUNT_PERFORM(count_Mate1plyDrop);
+			COUNT_PERFORM(Threads[threadID].mate1plyDrops);
 			CHK_MATE1PLY(m);
 			return VALUE_MATE;
 		}
@@ -2237,7 +2238,7 @@ int Position::Mate1ply(Move &m, uint32_t &info)
 		ret = CheckMate1plyMove<us>(info, m, check);
 		if (ret != 0) {
 			assert(is_ok(m));
-			COUNT_PERFORM(count_Mate1plyMove);
+			COUNT_PERFORM(Threads[threadID].mate1plyMoves);
 			CHK_MATE1PLY(m);
 			return VALUE_MATE;
 		}
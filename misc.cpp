@@ -23,6 +23,12 @@
 #  include <sys/time.h>
 #  include <sys/types.h>
 #  include <unistd.h>
+#  if defined(__linux__)
+#     include <sched.h>
+#     include <sys/ioctl.h>
+#     include <sys/syscall.h>
+#     include <linux/perf_event.h>
+#  endif
 #  if defined(__hpux)
 #     include <sys/pstat.h>
 #  endif
@@ -39,7 +45,14 @@
 #  include <xmmintrin.h>
 #endif
 
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#  include <x86intrin.h>
+#endif
+
 #include <cassert>
+#include <cstring>
 #include <cstdio>
 #include <iomanip>
 #include <iostream>
@@ -193,6 +206,215 @@ int cpu_count() {
 }
 
 
+/// NUMA helpers. The topology is read from sysfs and memory is bound with the
+/// mbind() system call directly, so libnuma is not needed. On other systems,
+/// or when the topology can't be read, there is a single node 0 and binding
+/// does nothing.
+
+#if defined(__linux__)
+namespace {
+
+	const int MaxNumaNodes = 8;
+	int NumaNodes = -1;
+	cpu_set_t NumaCpus[MaxNumaNodes];
+
+	// Parse a sysfs cpulist such as "0-7,16-23"
+	bool read_cpulist(const char* fname, cpu_set_t* set) {
+
+		FILE* f = fopen(fname, "r");
+		if (!f)
+			return false;
+
+		int a, b;
+		char c;
+		CPU_ZERO(set);
+		while (fscanf(f, "%d", &a) == 1)
+		{
+			b = a;
+			if ((c = char(fgetc(f))) == '-' && fscanf(f, "%d", &b) == 1)
+				c = char(fgetc(f));
+			for (int i = a; i <= b && i < CPU_SETSIZE; i++)
+				CPU_SET(i, set);
+			if (c != ',')
+				break;
+		}
+		fclose(f);
+		return CPU_COUNT(set) > 0;
+	}
+
+	void init_numa() {
+
+		char fname[64];
+		NumaNodes = 0;
+		while (NumaNodes < MaxNumaNodes)
+		{
+			sprintf(fname, "/sys/devices/system/node/node%d/cpulist", NumaNodes);
+			if (!read_cpulist(fname, &NumaCpus[NumaNodes]))
+				break;
+			NumaNodes++;
+		}
+		if (NumaNodes == 0)
+			NumaNodes = 1;
+	}
+}
+#endif
+
+int numa_node_count() {
+
+#if defined(__linux__)
+	if (NumaNodes < 0)
+		init_numa();
+	return NumaNodes;
+#else
+	return 1;
+#endif
+}
+
+/// numa_bind_self() restricts the calling thread to the CPUs of the node, or
+/// lets it run anywhere again if node is negative.
+
+bool numa_bind_self(int node) {
+
+#if defined(__linux__)
+	if (numa_node_count() <= 1 || node >= NumaNodes)
+		return false;
+
+	cpu_set_t set;
+	if (node >= 0)
+		set = NumaCpus[node];
+	else
+	{
+		CPU_ZERO(&set);
+		for (int n = 0; n < NumaNodes; n++)
+			CPU_OR(&set, &set, &NumaCpus[n]);
+	}
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)node;
+	return false;
+#endif
+}
+
+/// numa_bind_memory() asks the kernel to place the pages of [addr, addr + size)
+/// on the node. It must be called before the pages are touched for the first
+/// time, addr must be page aligned.
+
+bool numa_bind_memory(void* addr, size_t size, int node) {
+
+#if defined(__linux__) && defined(SYS_mbind)
+	if (numa_node_count() <= 1 || node < 0 || node >= NumaNodes)
+		return false;
+
+	const long MpolBind = 2;
+	unsigned long mask = 1UL << node;
+	return syscall(SYS_mbind, addr, size, MpolBind, &mask, sizeof(mask) * 8, 0) == 0;
+#else
+	(void)addr; (void)size; (void)node;
+	return false;
+#endif
+}
+
+
+/// cpu_ticks() returns the time stamp counter on x86, so that short pieces of
+/// code can be timed when the cycle counter is not available. Elsewhere it
+/// returns microseconds.
+
+uint64_t cpu_ticks() {
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return uint64_t(get_system_time()) * 1000;
+#endif
+}
+
+
+/// PerfCounters opens every event as its own counter, so that an event the
+/// CPU lacks doesn't disable the others. The counters start at once and only
+/// count in user mode. When the kernel has to multiplex them, an event runs
+/// only part of the time, so delta() scales the increase of the raw count by
+/// the increases of the enabled and running times over the same interval.
+
+PerfCounters::PerfCounters() {
+
+	for (int e = 0; e < EVENT_NB; e++)
+		fd[e] = -1;
+
+#if defined(__linux__) && defined(SYS_perf_event_open)
+	const uint32_t type[EVENT_NB] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE
+	};
+	const uint64_t config[EVENT_NB] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D  | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+	};
+
+	for (int e = 0; e < EVENT_NB; e++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type[e];
+		attr.config = config[e];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fd[e] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+
+#if defined(__linux__)
+	for (int e = 0; e < EVENT_NB; e++)
+		if (fd[e] >= 0)
+			close(fd[e]);
+#endif
+}
+
+void PerfCounters::read(Sample& s) const {
+
+	for (int e = 0; e < EVENT_NB; e++)
+	{
+		s.value[e] = s.enabled[e] = s.running[e] = 0;
+#if defined(__linux__)
+		uint64_t buf[3]; // value, time enabled, time running
+		if (fd[e] < 0 || ::read(fd[e], buf, sizeof(buf)) != ssize_t(sizeof(buf)))
+			continue;
+
+		s.value[e] = buf[0];
+		s.enabled[e] = buf[1];
+		s.running[e] = buf[2];
+#endif
+	}
+}
+
+uint64_t PerfCounters::delta(const Sample& before, const Sample& after, Event e) {
+
+	const uint64_t value   = after.value[e]   - before.value[e];
+	const uint64_t enabled = after.enabled[e] - before.enabled[e];
+	const uint64_t running = after.running[e] - before.running[e];
+
+	// Not scheduled at all in the interval, nothing is known about it
+	if (running == 0)
+		return 0;
+
+	return running < enabled ? uint64_t(double(value) * enabled / running) : value;
+}
+
+const char* PerfCounters::name(Event e) {
+
+	static const char* const names[EVENT_NB] = {
+		"cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses"
+	};
+	return names[e];
+}
+
+
 /// Check for console input. Original code from Beowulf, Olithink and Greko
 
 #ifndef _WIN32
@@ -28,8 +28,39 @@ extern const std::string engine_name();
 extern const std::string engine_authors();
 extern int get_system_time();
 extern int cpu_count();
+extern int numa_node_count();
+extern bool numa_bind_self(int node);
+extern bool numa_bind_memory(void* addr, size_t size, int node);
 extern int input_available();
 extern void prefetch(char* addr);
+extern uint64_t cpu_ticks();
+
+
+/// PerfCounters counts hardware events of the calling thread with the Linux
+/// perf_event_open() system call. Events the kernel or the CPU doesn't provide
+/// (or all of them on other systems) are not available.
+
+struct PerfCounters {
+
+	enum Event { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, EVENT_NB };
+
+	/// Raw cumulative readings, to be scaled only as differences by delta()
+	struct Sample {
+		uint64_t value[EVENT_NB], enabled[EVENT_NB], running[EVENT_NB];
+	};
+
+	PerfCounters();
+	~PerfCounters();
+	bool available(Event e) const { return fd[e] >= 0; }
+	void read(Sample& s) const;
+	static uint64_t delta(const Sample& before, const Sample& after, Event e);
+	static const char* name(Event e);
+
+private:
+	PerfCounters(const PerfCounters&);
+	PerfCounters& operator=(const PerfCounters&);
+	int fd[EVENT_NB];
+};
 
 extern void dbg_hit_on(bool b);
 extern void dbg_hit_on_c(bool c, bool b);
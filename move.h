@@ -154,7 +154,7 @@ inline void move_print(Move m, int rotate = 0) {
 class Position;
 extern Move cons_move(Color us, unsigned char f, unsigned char t, const Position &k);
 
-inline Move cons_move(const int from, const int to, const Piece piece, const Piece capture, const int promote=0, const unsigned int K=0)
+inline Move cons_move(const int from, const int to, const int piece, const int capture, const int promote=0, const unsigned int K=0)
 {
 	unsigned int tmp;
 	tmp  = From2Move(from);
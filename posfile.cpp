@@ -0,0 +1,364 @@
+/*
+  NanohaMini, a USI shogi(japanese-chess) playing engine derived from Stockfish 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad (Stockfish author)
+  Copyright (C) 2014 Kazuyuki Kawabata
+
+  NanohaMini is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  NanohaMini is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#if defined(_MSC_VER) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "posfile.h"
+#include "position.h"
+
+using namespace std;
+
+namespace {
+
+	// xɓǂݍރR[h
+	const size_t ReadRecords = 4096;
+
+	const char* StartSFEN = "lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1";
+
+}
+
+size_t posfile_record_size(int flags)
+{
+	size_t size = 32;
+	if (flags & POSFILE_SCORE)  size += sizeof(int16_t);
+	if (flags & POSFILE_MOVE)   size += sizeof(uint32_t);
+	if (flags & POSFILE_RESULT) size += sizeof(int8_t);
+	return size;
+}
+
+bool PosFileWriter::open(const string& fileName, int f)
+{
+	close();
+	fp = fopen(fileName.c_str(), "wb");
+	if (fp == NULL) {
+		perror(fileName.c_str());
+		return false;
+	}
+	flags = f;
+	count = 0;
+
+	// R[h close() ŏ
+	PosFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = POSFILE_MAGIC;
+	header.version = POSFILE_VERSION;
+	header.flags = uint16_t(flags);
+	header.recordSize = uint32_t(posfile_record_size(flags));
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+		perror(fileName.c_str());
+		fclose(fp);
+		fp = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool PosFileWriter::write(const Position& pos, int score, Move move, int result)
+{
+	unsigned char data[32 + sizeof(int16_t) + sizeof(uint32_t) + sizeof(int8_t)];
+	unsigned char board[9][9];
+	int h[GRY+1];
+	Color c;
+
+	// łȂǖʂ͏Ȃ
+	if (fp == NULL || pos.EncodeHuffman(data) < 0 || Position::DecodeHuffman(data, board, h, c) < 0)
+		return false;
+
+	size_t size = 32;
+	if (flags & POSFILE_SCORE) {
+		int16_t s = int16_t(score);
+		memcpy(data + size, &s, sizeof(s));
+		size += sizeof(s);
+	}
+	if (flags & POSFILE_MOVE) {
+		uint32_t m = uint32_t(move);
+		memcpy(data + size, &m, sizeof(m));
+		size += sizeof(m);
+	}
+	if (flags & POSFILE_RESULT) {
+		data[size++] = (unsigned char)int8_t(result);
+	}
+	if (fwrite(data, size, 1, fp) != 1)
+		return false;
+	count++;
+	return true;
+}
+
+void PosFileWriter::close()
+{
+	if (fp == NULL)
+		return;
+
+	if (fseek(fp, offsetof(PosFileHeader, count), SEEK_SET) != 0 || fwrite(&count, sizeof(count), 1, fp) != 1)
+		perror("PosFileWriter::close");
+	fclose(fp);
+	fp = NULL;
+}
+
+PositionReader::PositionReader() : fp(NULL), bufPos(0), bufLen(0), done(0),
+                                   text(NULL), textSize(0), mapHandle(NULL), sfenIndex(0)
+{
+	memset(&header, 0, sizeof(header));
+	memset(&rec, 0, sizeof(rec));
+}
+
+PositionReader::~PositionReader()
+{
+	close();
+}
+
+void PositionReader::close()
+{
+	if (fp != NULL) {
+		fclose(fp);
+		fp = NULL;
+	}
+	buf.clear();
+	bufPos = bufLen = 0;
+	done = 0;
+	if (text != NULL) {
+#if defined(_MSC_VER) || defined(_WIN32)
+		UnmapViewOfFile(text);
+		CloseHandle(mapHandle);
+#else
+		munmap(const_cast<char *>(text), textSize);
+#endif
+		text = NULL;
+		textSize = 0;
+		mapHandle = NULL;
+	}
+	sfenList.clear();
+	sfenIndex = 0;
+}
+
+// SFEN eLXgǂݎp mmap 
+bool PositionReader::map_text(const string& fileName)
+{
+#if defined(_MSC_VER) || defined(_WIN32)
+	HANDLE fh = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fh == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER li;
+	if (GetFileSizeEx(fh, &li)) textSize = size_t(li.QuadPart);
+	if (textSize > 0) {
+		mapHandle = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapHandle != NULL) {
+			text = static_cast<const char *>(MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0));
+			if (text == NULL) CloseHandle(mapHandle);
+		}
+	}
+	CloseHandle(fh);
+#else
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0) textSize = size_t(st.st_size);
+	if (textSize > 0) {
+		void *p = mmap(NULL, textSize, PROT_READ, MAP_SHARED, fd, 0);
+		if (p != MAP_FAILED) {
+			text = static_cast<const char *>(p);
+			madvise(p, textSize, MADV_SEQUENTIAL);
+		}
+	}
+	::close(fd);
+#endif
+	if (text == NULL) {
+		// ̃t@C͋ǖʂȂƂĈ
+		const bool empty = (textSize == 0);
+		textSize = 0;
+		mapHandle = NULL;
+		return empty;
+	}
+	split_lines(text, text + textSize);
+	return true;
+}
+
+// sčs̈ʒuoBs CR Ɛ擪 "sfen " ͏B
+void PositionReader::split_lines(const char* p, const char* end)
+{
+	while (p < end) {
+		const char *eol = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+		if (eol == NULL) eol = end;
+		const char *q = eol;
+		if (q > p && q[-1] == '\r') q--;
+		if (q - p >= 5 && memcmp(p, "sfen ", 5) == 0) p += 5;
+		if (q > p)
+			sfenList.push_back(make_pair(p, size_t(q - p)));
+		p = eol + 1;
+	}
+}
+
+// ǖʃt@C̓wb_ magic Ŕʂ
+bool PositionReader::open(const string& fileName)
+{
+	close();
+
+	FILE *f = fopen(fileName.c_str(), "rb");
+	if (f == NULL)
+		return false;
+
+	if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == POSFILE_MAGIC) {
+		if (header.version != POSFILE_VERSION || header.recordSize != posfile_record_size(header.flags)) {
+			cerr << fileName << ": unsupported position file (version " << header.version << ")" << endl;
+			fclose(f);
+			return false;
+		}
+		fp = f;
+		buf.resize(ReadRecords * header.recordSize);
+		return true;
+	}
+	fclose(f);
+
+	return map_text(fileName);
+}
+
+// sfens[] ͓ǂݏI܂ŎcĂ邱
+void PositionReader::open(const string sfens[])
+{
+	close();
+	for (int i = 0; !sfens[i].empty(); i++)
+		split_lines(sfens[i].data(), sfens[i].data() + sfens[i].size());
+}
+
+size_t PositionReader::size() const
+{
+	return fp != NULL ? size_t(header.count) : sfenList.size();
+}
+
+bool PositionReader::fill()
+{
+	if (done >= header.count)
+		return false;
+	uint64_t n = header.count - done;
+	if (n > ReadRecords) n = ReadRecords;
+	n = fread(&buf[0], header.recordSize, size_t(n), fp);
+	bufPos = 0;
+	bufLen = size_t(n) * header.recordSize;
+	return n > 0;
+}
+
+// ̋ǖʂ pos ɐݒ肷BI܂œǂ񂾂 false ԂB
+bool PositionReader::next(Position& pos)
+{
+	if (fp == NULL) {
+		for (;;) {
+			if (sfenIndex >= sfenList.size())
+				return false;
+			const pair<const char*, size_t>& line = sfenList[sfenIndex++];
+			if (pos.from_fen(line.first, line.second))
+				return true;
+			cerr << "Error in SFEN string: " << string(line.first, line.second) << endl;
+		}
+	}
+
+	for (;;) {
+		if (bufPos >= bufLen && !fill())
+			return false;
+
+		const unsigned char *p = &buf[bufPos];
+		bufPos += header.recordSize;
+		done++;
+
+		memcpy(rec.packed, p, 32);
+		p += 32;
+		rec.score = 0;
+		rec.move = MOVE_NONE;
+		rec.result = 0;
+		if (header.flags & POSFILE_SCORE) {
+			int16_t s;
+			memcpy(&s, p, sizeof(s));
+			rec.score = s;
+			p += sizeof(s);
+		}
+		if (header.flags & POSFILE_MOVE) {
+			uint32_t m;
+			memcpy(&m, p, sizeof(m));
+			rec.move = Move(m);
+			p += sizeof(m);
+		}
+		if (header.flags & POSFILE_RESULT) {
+			rec.result = int8_t(*p);
+		}
+
+		if (pos.from_packed(rec.packed))
+			return true;
+		cerr << "Broken position record: " << done << endl;
+	}
+}
+
+// ǖʂϊ
+//   posconv <> <o> [sfen]
+//   ͂͋ǖʃt@C SFEN eLXgBsfen w肷 SFEN eLXgŏo͂B
+void convert_positions(int argc, char* argv[])
+{
+	if (argc < 3) {
+		cerr << "Usage: posconv <input file> <output file> [sfen]" << endl;
+		exit(EXIT_FAILURE);
+	}
+	const string inFile = argv[1];
+	const string outFile = argv[2];
+	const bool toText = argc > 3 && string(argv[3]) == "sfen";
+
+	PositionReader reader;
+	if (!reader.open(inFile)) {
+		cerr << "Unable to open file " << inFile << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	PosFileWriter writer;
+	ofstream out;
+	if (toText) {
+		out.open(outFile.c_str());
+		if (!out.is_open()) {
+			cerr << "Unable to open file " << outFile << endl;
+			exit(EXIT_FAILURE);
+		}
+	} else if (!writer.open(outFile, reader.flags())) {
+		exit(EXIT_FAILURE);
+	}
+
+	Position pos(StartSFEN, 0);
+	uint64_t n = 0, skipped = 0;
+	while (reader.next(pos)) {
+		n++;
+		if (toText) {
+			out << "sfen " << pos.to_fen() << "\n";
+		} else if (!writer.write(pos, reader.record().score, reader.record().move, reader.record().result)) {
+			cerr << "Skip position " << n << ": " << pos.to_fen() << endl;
+			skipped++;
+		}
+	}
+	writer.close();
+
+	cerr << "Positions: " << n << ", skipped: " << skipped << endl;
+}
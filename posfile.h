@@ -0,0 +1,129 @@
+/*
+  NanohaMini, a USI shogi(japanese-chess) playing engine derived from Stockfish 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2010 Marco Costalba, Joona Kiiski, Tord Romstad (Stockfish author)
+  Copyright (C) 2014 Kazuyuki Kawabata
+
+  NanohaMini is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  NanohaMini is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(POSFILE_H_INCLUDED)
+#define POSFILE_H_INCLUDED
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "move.h"
+
+class Position;
+
+/*
+  ǖʃt@Č`
+
+  wb_(24oCg)̌ɌŒ蒷̃R[h count ԁBl̓gGfBAB
+  R[h EncodeHuffman() ŋl߂ǖ(32oCg)Ŏn܂A
+  flags Ŏw肵tB[h̏őB
+    POSFILE_SCORE  : ]l int16_t (ԑ猩l)
+    POSFILE_MOVE   : w uint32_t
+    POSFILE_RESULT : s int8_t (ԑ猩 1: 0: -1:)
+  ՏƎŋ40ĂȂǖ(lȂ)͊i[łȂB
+*/
+
+const uint32_t POSFILE_MAGIC   = 0x534F504E;	// "NPOS"
+const uint16_t POSFILE_VERSION = 1;
+
+enum PosFileFlags {
+	POSFILE_SCORE  = 1,
+	POSFILE_MOVE   = 2,
+	POSFILE_RESULT = 4
+};
+
+struct PosFileHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	uint32_t recordSize;
+	uint32_t reserved;
+	uint64_t count;
+};
+
+struct PosRecord {
+	unsigned char packed[32];
+	int score;
+	Move move;
+	int result;
+};
+
+size_t posfile_record_size(int flags);
+
+/// PosFileWriter ͋ǖʃt@CBR[h close() Ńwb_ɏ߂B
+
+class PosFileWriter {
+public:
+	PosFileWriter() : fp(NULL), flags(0), count(0) {}
+	~PosFileWriter() { close(); }
+	bool open(const std::string& fileName, int flags);
+	bool write(const Position& pos, int score = 0, Move move = MOVE_NONE, int result = 0);
+	void close();
+	uint64_t size() const { return count; }
+
+private:
+	PosFileWriter(const PosFileWriter&);
+	PosFileWriter& operator=(const PosFileWriter&);
+
+	FILE* fp;
+	int flags;
+	uint64_t count;
+};
+
+/// PositionReader ͋ǖʂ擪珇ɓǂށBǖʃt@C͂܂Ƃ߂ēǂݍ񂾕
+/// ̓sxWJAȊO1s1ǖʂ SFEN eLXg("sfen " ͏ȗ)ƂēǂށB
+/// SFEN eLXg mmap čs̈ʒuoĂAnext() Œډ߂B
+
+class PositionReader {
+public:
+	PositionReader();
+	~PositionReader();
+	bool open(const std::string& fileName);
+	void open(const std::string sfens[]);	// 󕶎ŏIgݍ݂̋ǖ
+	bool next(Position& pos);
+	size_t size() const;
+	bool is_binary() const { return fp != NULL; }
+	int flags() const { return fp != NULL ? header.flags : 0; }
+	const PosRecord& record() const { return rec; }	// ǖʃt@Cǂ񂾂Ƃ̒ÕR[h
+
+private:
+	PositionReader(const PositionReader&);
+	PositionReader& operator=(const PositionReader&);
+	void close();
+	bool fill();
+	bool map_text(const std::string& fileName);
+	void split_lines(const char* p, const char* end);
+
+	FILE* fp;
+	PosFileHeader header;
+	std::vector<unsigned char> buf;
+	size_t bufPos, bufLen;
+	uint64_t done;
+	const char* text;	// mmap  SFEN eLXg
+	size_t textSize;
+	void* mapHandle;
+	std::vector<std::pair<const char*, size_t> > sfenList;
+	size_t sfenIndex;
+	PosRecord rec;
+};
+
+#endif // !defined(POSFILE_H_INCLUDED)
@@ -54,6 +54,7 @@ using std::endl;
 
 #if defined(NANOHA)
 Key Position::zobrist[GRY+1][0x100];
+Key Position::zobHand[2][HI+1][19];
 #else
 Key Position::zobrist[2][8][64];
 Key Position::zobEp[64];
@@ -171,7 +172,7 @@ namespace {
 
 #if defined(NANOHA)
 	// To convert a Piece to and from a FEN char
-	const string PieceToChar(".PLNSGBRKPLNS.BRplnsgbrkplns.br");
+	const string PieceToChar(".PLNSGBRKPLNS.BR.plnsgbrkplns.br");
 
 	struct PieceType2Str : public std::map<PieceType, std::string> {
 	PieceType2Str() {
@@ -219,6 +220,15 @@ namespace {
 			operator[]('L') = SKY;	operator[]('l') = GKY;
 			operator[]('P') = SFU;	operator[]('p') = GFU;
 			operator[]('.') = EMP;
+
+			memset(tbl, -1, sizeof(tbl));
+			for (const_iterator it = begin(); it != end(); ++it)
+				tbl[int(it->first)] = static_cast<signed char>(it->second);
+		}
+
+		// SFEN ̕ɕϊ(łȂ -1)
+		int code(char c) const {
+			return (c & 0x80) ? -1 : tbl[int(c)];
 		}
 
 		string from_piece(Piece p) const {
@@ -234,6 +244,9 @@ namespace {
 			assert(false);
 			return 0;
 		}
+
+	private:
+		signed char tbl[128];
 	};
 
 	PieceLetters pieceLetters;
@@ -268,21 +281,35 @@ CheckInfo::CheckInfo(const Position& pos) {
 
 Position::Position(const Position& pos, int th) {
 
-	memcpy(this, &pos, sizeof(Position));
-	threadID = th;
-	nodes = 0;
 #if defined(NANOHA)
+	// ǖʂ̏ (st  effect[] ܂) ʂBstartState ͎ʂȂB
+	// st ͌̋ǖʂ StateInfo w܂܂ɂȂ̂ŁA]̑S̃Rs[ƓB
+	memcpy(&st, &pos.st, (const char *)(effect + 2) - (const char *)&st);
+	startPosPly = pos.startPosPly;
 	tnodes = 0;
-#if defined(CHK_PERFORM)
-	count_Mate1plyDrop = 0;		// łŋl񂾉
-	count_Mate1plyMove = 0;		// ړŋl񂾉
-	count_Mate3ply = 0;			// Mate3()ŋl񂾉
-#endif // defined(CHK_PERFORM)
+	repReady = false;
+#else
+	memcpy(this, &pos, sizeof(Position));
 #endif
+	threadID = th;
+	nodes = 0;
 
 	assert(is_ok());
 }
 
+#if defined(CHK_PERFORM)
+// lݒT̉񐔂̓Rs[̂тɏȂčςނ悤ɃXbhƂɎ
+unsigned long Position::mate3_searched() const {
+	return Threads[threadID].mate3plyMates;
+}
+void Position::set_mate3_searched(unsigned long n) {
+	Threads[threadID].mate3plyMates = n;
+}
+void Position::inc_mate3_searched(unsigned long n) {
+	Threads[threadID].mate3plyMates += n;
+}
+#endif // defined(CHK_PERFORM)
+
 #if defined(NANOHA)
 Position::Position(const string& fen, int th) {
 #else
@@ -304,6 +331,15 @@ Position::Position(const string& fen, bool isChess960, int th) {
 
 #if defined(NANOHA)
 void Position::from_fen(const string& fenStr) {
+
+	if (!from_fen(fenStr.data(), fenStr.size()))
+		std::cerr << "Error in SFEN string: " << fenStr << endl;
+}
+
+/// Rs[ [fenStr, fenStr+len) ߂B
+/// ǖʃt@C̓ǂݍ݂ȂǁAʂ̋ǖʂ𓯂 Position ɏɓǂݍނƂɎgB
+
+bool Position::from_fen(const char* fenStr, size_t len) {
 #else
 void Position::from_fen(const string& fenStr, bool isChess960) {
 #endif
@@ -336,63 +372,61 @@ void Position::from_fen(const string& fenStr, bool isChess960) {
 */
 
 #if defined(NANOHA)
-	char token;
-	std::istringstream fen(fenStr);
+	const char *p = fenStr;
+	const char *const end = fenStr + len;
+	int piece;
 
 	unsigned char tmp_ban[9][9] = {{'\0'}};
 	int tmp_hand[GRY+1] = {0};
 
 	clear();
-	fen >> std::noskipws;
 
 	// 1. Piece placement
 	int dan = 0;
 	int suji = 0; // ́u؁vƂ̂́AʂƂ͔]̂ɂȂB
-	while ((fen >> token) && !isspace(token))
+	for (; p < end && !isspace(static_cast<unsigned char>(*p)); p++)
 	{
-		if (token == '+') {
+		if (*p == '+') {
 			// 
-			fen >> token;
-			if (pieceLetters.find(token) == pieceLetters.end()) goto incorrect_fen;
-			tmp_ban[dan][suji++] = static_cast<unsigned char>(pieceLetters[token] | PROMOTED);
-		} else if (pieceLetters.find(token) != pieceLetters.end())
+			if (++p == end || (piece = pieceLetters.code(*p)) < 0) goto incorrect_fen;
+			tmp_ban[dan][suji++] = static_cast<unsigned char>(piece | PROMOTED);
+		} else if ((piece = pieceLetters.code(*p)) >= 0)
 		{
-			tmp_ban[dan][suji++] = static_cast<unsigned char>(pieceLetters[token]);
+			tmp_ban[dan][suji++] = static_cast<unsigned char>(piece);
 		}
-		else if (isdigit(token)) {
-			suji += (token - '0');	// ̕
-		} else if (token == '/') {
+		else if (isdigit(static_cast<unsigned char>(*p))) {
+			suji += (*p - '0');	// ̕
+		} else if (*p == '/') {
 			if (suji != 9) goto incorrect_fen;
 			suji = 0;
 			dan++;
 		} else {
 			goto incorrect_fen;
 		}
-		if (dan > 9 || suji > 9) goto incorrect_fen;
+		if (dan > 8 || suji > 9) goto incorrect_fen;
 	}
-	if (dan != 9 && suji != 9) goto incorrect_fen;
+	if (dan != 8 || suji != 9) goto incorrect_fen;
 
 	// Ԏ擾
-	if (!fen.get(token) || (token != 'w' && token != 'b')) goto incorrect_fen;
-	sideToMove = (token == 'b') ? BLACK : WHITE;
+	if (p == end || ++p == end || (*p != 'w' && *p != 'b')) goto incorrect_fen;
+	sideToMove = (*p == 'b') ? BLACK : WHITE;
 	// Xy[X΂
-	if (!fen.get(token) || token != ' ') goto incorrect_fen;
+	if (++p == end || *p != ' ') goto incorrect_fen;
 
 	// 
-	while ((fen >> token) && token != ' ') {
+	for (p++; p < end && *p != ' '; p++) {
 		int num = 1;
-		if (token == '-') {
+		if (*p == '-') {
+			p++;
 			break;
-		} else if (isdigit(token)) {
-			num = token - '0';
-			fen >> token;
-			if (isdigit(token)) {
-				num = 10*num + token - '0';
-				fen >> token;
+		} else if (isdigit(static_cast<unsigned char>(*p))) {
+			num = *p++ - '0';
+			if (p < end && isdigit(static_cast<unsigned char>(*p))) {
+				num = 10*num + *p++ - '0';
 			}
 		}
-		if (pieceLetters.find(token) == pieceLetters.end()) goto incorrect_fen;
-		tmp_hand[pieceLetters[token]] = num;
+		if (p == end || (piece = pieceLetters.code(*p)) <= EMP || (piece & ~GOTE) == OU) goto incorrect_fen;
+		tmp_hand[piece] = num;
 	}
 	init_position(tmp_ban, tmp_hand);
 
@@ -444,7 +478,13 @@ void Position::from_fen(const string& fenStr, bool isChess960) {
 
 	// 5-6. Halfmove clock and fullmove number
 #if defined(NANOHA)
-	fen >> std::skipws >> startPosPly;
+	while (p < end && *p == ' ') p++;
+	startPosPly = 1;	// 萔ȗꂽƂ(from_packed Ɠ)
+	if (p < end && isdigit(static_cast<unsigned char>(*p))) {
+		startPosPly = 0;
+		while (p < end && isdigit(static_cast<unsigned char>(*p)))
+			startPosPly = 10*startPosPly + *p++ - '0';
+	}
 #else
 	fen >> std::skipws >> st->rule50 >> startPosPly;
 #endif
@@ -467,6 +507,8 @@ void Position::from_fen(const string& fenStr, bool isChess960) {
 #if defined(NANOHA)
 	st->hand = hand[sideToMove].h;
 	st->effect = (sideToMove == BLACK) ? effectB[kingG] : effectW[kingS];
+	init_camp();
+	init_repetition(st);
 	material = compute_material();
 #else
 	st->pawnKey = compute_pawn_key();
@@ -478,14 +520,45 @@ void Position::from_fen(const string& fenStr, bool isChess960) {
 
 	assert(is_ok());
 #if defined(NANOHA)
-	return;
+	return true;
 
 incorrect_fen:
-	std::cerr << "Error in SFEN string: " << fenStr << endl;
+	return false;
 #endif
 }
 
 
+#if defined(NANOHA)
+/// Position::from_packed()  EncodeHuffman() 32oCgɋl߂ǖʂZbgB
+/// łȂ(ĂȂ)Ƃ false ԂAǖʂ͕ςȂB
+
+bool Position::from_packed(const unsigned char buf[32]) {
+
+	unsigned char tmp_ban[9][9];
+	int tmp_hand[GRY+1];
+	Color c;
+
+	if (DecodeHuffman(buf, tmp_ban, tmp_hand, c) < 0)
+		return false;
+
+	clear();
+	sideToMove = c;
+	init_position(tmp_ban, tmp_hand);
+	startPosPly = 1;
+
+	st->key = compute_key();
+	st->hand = hand[sideToMove].h;
+	st->effect = (sideToMove == BLACK) ? effectB[kingG] : effectW[kingS];
+	init_camp();
+	init_repetition(st);
+	material = compute_material();
+
+	assert(is_ok());
+	return true;
+}
+#endif
+
+
 #if !defined(NANOHA)
 /// Position::set_castle() is an helper function used to set
 /// correct castling related flags.
@@ -567,7 +640,7 @@ const string Position::to_fen() const {
 					emptyCnt = 0;
 				}
 #if defined(NANOHA)
-				if (piece_on(sq) & PROMOTED) {
+				if ((piece_on(sq) & ~GOTE) > OU) {
 					fen << "+";
 				}
 #endif
@@ -580,7 +653,11 @@ const string Position::to_fen() const {
 		if (emptyCnt)
 			fen << emptyCnt;
 
+#if defined(NANOHA)
+		if (rank < RANK_9)
+#else
 		if (rank > RANK_1)
+#endif
 			fen << '/';
 	}
 
@@ -619,6 +696,7 @@ const string Position::to_fen() const {
 
 #undef ADD_HAND
 	}
+	fen << " " << startPosPly;
 #else
 	if (st->castleRights != CASTLES_NONE)
 	{
@@ -1740,6 +1818,15 @@ void Position::do_null_move(StateInfo& backupSt) {
 #endif
 	backupSt.previous = st->previous;
 	backupSt.pliesFromNull = st->pliesFromNull;
+#if defined(NANOHA)
+	// Ֆʂ͕ςȂ̂ŁAȂ̋ǖʂƂĕ]l̍vŽoHɓ
+	backupSt.evalValid = false;
+	backupSt.kingMoved = false;
+	backupSt.evalDiff.nRemoved = backupSt.evalDiff.nAdded = 0;
+	// Ԃς̂œǖʂ̐
+	backupSt.repetition = st->repetition;
+	st->repetition = 0;
+#endif
 	st->previous = &backupSt;
 
 #if !defined(NANOHA)
@@ -1792,6 +1879,9 @@ void Position::undo_null_move() {
 #endif
 	st->previous = backupSt->previous;
 	st->pliesFromNull = backupSt->pliesFromNull;
+#if defined(NANOHA)
+	st->repetition = backupSt->repetition;
+#endif
 
 	// Update the necessary information
 	sideToMove = flip(sideToMove);
@@ -2069,11 +2159,6 @@ void Position::clear() {
 	// BLACK.
 	sideToMove = BLACK;
 	tnodes = 0;
-#if defined(CHK_PERFORM)
-	count_Mate1plyDrop = 0;		// łŋl񂾉
-	count_Mate1plyMove = 0;		// ړŋl񂾉
-	count_Mate3ply = 0;			// Mate3()ŋl񂾉
-#endif // defined(CHK_PERFORM)
 #define FILL_ZERO(x)	memset(x, 0, sizeof(x))
 	FILL_ZERO(banpadding);
 	FILL_ZERO(ban);
@@ -2135,6 +2220,10 @@ Key Position::compute_key() const {
 			}
 		}
 	}
+	for (int c = BLACK; c <= WHITE; c++)
+		for (int pt = FU; pt <= HI; pt++)
+			for (int n = hand[c].get(pt); n > 0; n--)
+				result ^= zobHand[c][pt][n];
 	if (side_to_move() != BLACK)
 		result ^= zobSideToMove;
 #else
@@ -2244,32 +2333,34 @@ Value Position::compute_non_pawn_material(Color c) const {
 #if defined(NANOHA)
 bool Position::is_draw(int& ret) const {
 	ret=0;
-	int i = 5, e = st->pliesFromNull;
 
-	if (i <= e)
-	{
-		StateInfo* stp = st->previous->previous;
-		int rept = 0;
-		bool cont_check = (st->previous->effect && stp->previous->effect) ? true : false;
-
-		do {
-			stp = stp->previous->previous;
-			if (stp->previous->effect == 0) cont_check = false;
-
-			if (stp->key == st->key && stp->hand == st->hand) {
-				rept++;
-				// ߋ3(ǖʊ܂߂4)oĂ.
-				if (rept >= 3) {
-					if (cont_check) {ret = -1; return false; }
-					return true;
-				}
-			}
+	// ߋ3(ǖʊ܂߂4)oĂ.
+	if (st->repetition < 3)
+		return false;
+
+	// 1ڂ̎萔̊ԁAǂ炩ĂA̐ŉ̕
+	const int n = st->ply - st->sameKey->sameKey->sameKey->ply;
+	if (st->checkRun[side_to_move()] * 2 >= n) {ret = -1; return false; }
+	if (st->checkRun[flip(side_to_move())] * 2 >= n) {ret = 1; return false; }
+	return true;
+}
+
+/// Position::init_repetition()  s ܂ł̎菇Ő蔻p̃oPbg蒼B
+/// ǖʂZbgƂƁARs[ǖʂōŏ do_move() ƂɌĂԁB
+/// _̃Rs[͈̑wɏÎŁARs[ɂ͍ȂB
+/// 菇 StateInfo  sameKey, bucketPrev ͂̂܂܎gB
 
-			i +=2;
+void Position::init_repetition(StateInfo* s) {
 
-		} while (i < e);
+	memset(repHead, 0, sizeof(repHead));
+	repReady = true;
+
+	// Vǖʂ珇ɁAoPbg̐擪󂢂ĂΓ
+	const int n = s->pliesFromNull;
+	for (int i = 0; s && i <= n; i++, s = s->previous) {
+		StateInfo*& head = repHead[s->key & (REP_BUCKETS - 1)];
+		if (head == NULL) head = s;
 	}
-	return false;
 }
 #else
 template<bool SkipRepetition>
@@ -2354,6 +2445,10 @@ void Position::init() {
 #if defined(NANOHA)
 	zobSideToMove = (rk.rand<Key>() << 1) | 1;
 	zobExclusion  = (rk.rand<Key>() << 1);
+	for (int c = BLACK; c <= WHITE; c++)
+		for (int pt = FU; pt <= HI; pt++)
+			for (int n = 1; n < 19; n++)
+				zobHand[c][pt][n] = rk.rand<Key>() << 1;
 #else
 	zobSideToMove = rk.rand<Key>();
 	zobExclusion  = rk.rand<Key>();
@@ -2430,8 +2525,10 @@ bool Position::is_ok(int* failedStep) const {
 	// What features of the position should be verified?
 	const bool debugAll = false;
 #if defined(NANOHA)
+	const bool debugBitboards       = debugAll || false;
 	const bool debugKingCount       = debugAll || false;
 	const bool debugKingCapture     = debugAll || false;
+	const bool debugEffect          = debugAll || false;
 #else
 	const bool debugBitboards       = debugAll || false;
 	const bool debugKingCount       = debugAll || false;
@@ -2516,6 +2613,48 @@ bool Position::is_ok(int* failedStep) const {
 	// TODO:ʂ3ȏ̗sȏ
 //  if (debugCheckerCount && count_1s<CNT32>(st->checkersBB) > 2)
 //      return false;
+
+	// Bitboards OK?
+	if (failedStep) (*failedStep)++;
+	if (debugBitboards)
+	{
+		// Ֆʏƃrbg{[hvĂ邩
+		for (int z = 0x11; z <= 0x99; z++) {
+			const Piece p = Piece(ban[z]);
+			if (p == WALL) continue;
+			if (occupiedBB.test(z) != (p != EMP)) return false;
+			if (byColorBB[BLACK].test(z) != (p != EMP && color_of(p) == BLACK)) return false;
+			if (byColorBB[WHITE].test(z) != (p != EMP && color_of(p) == WHITE)) return false;
+			for (int k = SFU; k <= GRY; k++) {
+				if (byPieceBB[k].test(z) != (p == k)) return false;
+			}
+		}
+	}
+
+	// Effects and pins OK?
+	if (failedStep) (*failedStep)++;
+	if (debugEffect)
+	{
+		// XV( undo_move() ł̏߂)̌ʂAꂩvZEsƈv邩
+		// (Rs[RXgN^ is_ok() ĂԂ̂ŁA̋ǖʂŌvZČɖ߂)
+		Position &self = const_cast<Position&>(*this);
+		effect_t effectOrg[2][16*12];
+		int pinOrg[16*10];
+		memcpy(effectOrg, effect, sizeof(effect));
+		memcpy(pinOrg, pin, sizeof(pin));
+		StateInfo *stOrg = st;
+		StateInfo tmpSt;
+		self.st = &tmpSt;		// vZƂ̗݂ StateInfo ɏȂ
+		tmpSt.nEffectLog = tmpSt.nPinLog = 0;
+		self.init_effect();
+		self.make_pin_info();
+		const bool ok = memcmp(effect, effectOrg, sizeof(effect)) == 0
+		             && memcmp(pin + 0x11, pinOrg + 0x11, (0x99-0x11+1)*sizeof(pin[0])) == 0;
+		memcpy(self.effect, effectOrg, sizeof(effect));
+		memcpy(self.pin, pinOrg, sizeof(pin));
+		self.st = stOrg;
+		if (!ok) return false;
+	}
 #else
 	// Do both sides have exactly one king?
 	if (failedStep) (*failedStep)++;
@@ -24,9 +24,8 @@
 #if defined(NANOHA)
 #include <iostream>
 #include <cstdio>
-#else
-#include "bitboard.h"
 #endif
+#include "bitboard.h"
 #include "move.h"
 #include "types.h"
 
@@ -54,6 +53,38 @@ struct CheckInfo {
 ///
 class Position;
 
+#if defined(NANOHA)
+struct EvalFeatures;
+
+/// EvalDiff 1ő KPP ̓(list0, list1 ̑g)ێB
+/// ̈ړ()AA̖̕ωŁAꂼꍂX3B
+struct EvalDiff {
+	int nRemoved, nAdded;
+	short removed[3][2];
+	short added[3][2];
+};
+
+/// EffectLog, PinLog  do_move() ŏ(effect[c][z])ƃs(pin[z])̌̒lB
+/// undo_move() ͂tɏ߂B𒴂͏]ʂvZĖ߂B
+const int EFFECT_LOG_MAX = 96;
+const int PIN_LOG_MAX = 16;
+
+struct EffectLog {
+	uint32_t value;
+	uint8_t c;
+	uint8_t z;
+};
+
+struct PinLog {
+	uint8_t z;
+	int8_t dir;
+};
+
+/// ̔pɁAǖʂnbVL[̉ʃrbgŃoPbgɕB
+/// StateInfo::bucketPrev œoPbg̑ŐǖʂǂB
+const int REP_BUCKETS = 256;
+#endif
+
 struct StateInfo {
 #if defined(NANOHA)
 	int gamePly;
@@ -62,7 +93,28 @@ struct StateInfo {
 	Piece captured;
 	uint32_t hand;
 	uint32_t effect;
+	uint8_t campPieces[2];	// [] GwOiڈȓɂʈȊŐ̐(ʐ錾p)
+	uint8_t campBig[2];		// ̂̑(pn)̐
 	Key key;
+
+	// ]֐̍vZp(ReducedStateInfo ł̓Rs[Ȃ)
+	int evalSum[3];			// [0]:ʂKPP, [1]:ʂKPP, [2]:KK+KKP
+	bool evalValid;			// evalSum vZς݂
+	bool kingMoved;			// ʂ(SvZKv)
+	EvalDiff evalDiff;		// ̎ő
+
+	// ̔p(ReducedStateInfo ł̓Rs[Ȃ)
+	int ply;				// Jnǖʂ̎萔
+	int repetition;			// ǖʂ܂łɌꂽ
+	int checkRun[2];		// [] ĉ萔
+	StateInfo* sameKey;		// Oɓǖʂꂽ StateInfo
+	StateInfo* bucketPrev;	// oPbg̈O StateInfo
+
+	// ƃs̕ύX(ReducedStateInfo ł̓Rs[Ȃ)
+	int nEffectLog;			// 𒴂͋L^
+	int nPinLog;
+	EffectLog effectLog[EFFECT_LOG_MAX];
+	PinLog pinLog[PIN_LOG_MAX];
 #else
 	Key pawnKey, materialKey;
 	Value npMaterial[2];
@@ -80,6 +132,7 @@ struct StateInfo {
 #if defined(NANOHA)
 // ֐
 extern void init_application_once();	// st@CNɍs.
+extern void wait_application_init();	// init_application_once() ̓ǂݍ݂҂.
 #endif
 
 /// The position data structure. A position consists of the following data:
@@ -122,6 +175,8 @@ public:
 	// Text input/output
 #if defined(NANOHA)
 	void from_fen(const std::string& fen);
+	bool from_fen(const char* fen, size_t len);
+	bool from_packed(const unsigned char buf[32]);
 #else
 	void from_fen(const std::string& fen, bool isChess960);
 #endif
@@ -148,7 +203,16 @@ public:
 	// Side to move
 	Color side_to_move() const;
 
-#if !defined(NANOHA)
+#if defined(NANOHA)
+	// Տ̋̈ʒũrbg{[h
+	Bitboard occupied_squares() const;
+	Bitboard empty_squares() const;
+	Bitboard pieces(Color c) const;
+	Bitboard pieces(Piece p) const;
+	Bitboard pawn_files(const Color us) const;							// ̂؂̃}X(ɂȂ)
+	Bitboard drop_squares(const Color us, const PieceType pt) const;	// ptłĂ}X(ŝȂiA)
+	int count_in_enemy_camp(const Color us, int &big) const;			// GwɂʈȊŐ̖(bigɑ̖)
+#else
 	// Bitboard representation of the position
 	Bitboard empty_squares() const;
 	Bitboard occupied_squares() const;
@@ -226,9 +290,12 @@ public:
 	// Doing and undoing moves
 	void do_move(Move m, StateInfo& st);
 #if defined(NANOHA)
-	void do_drop(Move m);
+	// ԂƂɎ̉́Bdo_move(), undo_move() ͎ԂňxU蕪
+	template<Color us> void do_move(Move m, StateInfo& st);
+	template<Color us> void do_drop(Move m);
 	void undo_move(Move m);
-	void undo_drop(Move m);
+	template<Color us> void undo_move(Move m);
+	template<Color us> void undo_drop(Move m);
 	void do_null_move(StateInfo& st);
 	void undo_null_move();
 	// i߂ɃnbVvẐݍs
@@ -244,11 +311,17 @@ public:
 	// 萶Ŏg߂̊֐
 	// wʒuwɉʒu܂ŒT(WALL or  or ̈ʒuɂȂ)
 	int SkipOverEMP(int pos, const int dir) const;
+	// ʐ錾p̓Gw̋(StateInfo::campPieces, campBig)̍XV
+	void init_camp();
+	static bool in_enemy_camp(const Color us, const int z);
+	void add_camp(const Color us, const Piece p, const int d);
 	// ̍XV
 	void add_effect(const int z);					// ʒuz̗̋𔽉f
 	void del_effect(const int z, const Piece k);	
 	// ̉Z
 	template<Color>
+	int ray_end(const int z, const int dir) const;
+	template<Color>
 	void add_effect_straight(const int z, const int dir, const uint32_t bit);
 	template<Color>
 	void del_effect_straight(const int z, const int dir, const uint32_t bit);
@@ -301,8 +374,15 @@ public:
 
 	// ǖʂ̕]
 	static void init_evaluate();
+	static void release_evaluate();
 	int make_list(int * pscore, int list0[], int list1[] ) const;
+	int make_list_scan(int * pscore, int list0[], int list1[] ) const;
+	void make_eval_features(EvalFeatures &f) const;
 	int evaluate(const Color us) const;
+	void set_eval_diff(const Piece before, const int from, const Piece after, const int to, const Piece capture);
+	void calc_eval_full() const;
+	void calc_eval_diff(const StateInfo *base) const;
+	void invalidate_eval() const;
 
 	// 딻(bInaniwa ɃZbg邽 const łȂ)
 	bool IsInaniwa(const Color us);
@@ -339,6 +419,7 @@ public:
 
 	// ǖʂHuffman
 	int EncodeHuffman(unsigned char buf[32]) const;
+	static int DecodeHuffman(const unsigned char buf[32], unsigned char board[9][9], int hand[GRY+1], Color &side);
 #endif
 
 	// Static exchange evaluation
@@ -425,6 +506,17 @@ private:
 
 #if defined(NANOHA)
 	void init_position(const unsigned char board_ori[9][9], const int Mochigoma_ori[]);
+	void xor_piece_bb(const Piece p, const int z);		// ʒuz̋prbg{[hɒu/菜
+	// Es̕ύX
+	void log_effect(const int c, const int z);
+	void log_pin(const int z);
+	bool effect_logged() const;
+	void restore_effect_log();
+	int hand_piece_number(const Color us, const int pt) const;	// pt̋ԍ
+	// ̔p̋ǖʂ̗
+	void init_repetition(StateInfo* s);
+	void push_repetition(const Color us);
+	void pop_repetition();
 	void make_pin_info();
 	void init_effect();
 #endif
@@ -471,17 +563,12 @@ private:
 #endif
 
 #if defined(NANOHA)
-	Piece banpadding[16*2];		// Padding
-	Piece ban[16*12];			// Տ ()
-	PieceNumber_t komano[16*12];		// Տ (ԍ)
-#define MAX_KOMANO	40
-	effect_t effect[2][16*12];				// 
-#define effectB	effect[BLACK]
-#define effectW	effect[WHITE]
-
-#define IsCheckS()	EXIST_EFFECT(effectW[kingS])	/* ʂɉ肪Ă邩? */
-#define IsCheckG()	EXIST_EFFECT(effectB[kingG])	/* ʂɉ肪Ă邩? */
-	int pin[16*10];					// s(ƌ藼p)
+	//  effect[] ܂łǖʂ̏ԁBRs[RXgN^͈͂̔͂ʂB
+	// do_move() ƕ]֐G鏬Ȃ̂擪̃LbVCɊ񂹂ĂB
+	StateInfo* st;
+	Color sideToMove;		// Ԃ̐F
+	int material;
+	bool bInaniwa;
 	Hand hand[2];					// 
 #define handS	hand[BLACK]
 #define handG	hand[WHITE]
@@ -522,8 +609,20 @@ private:
 #define kyPos	(&knpos[19])
 #define IsHand(x)	((x) <  0x11)
 #define OnBoard(x)	((x) >= 0x11)
-	int material;
-	bool bInaniwa;
+	PieceKind_t banpadding[16*2];		// Padding
+	PieceKind_t ban[16*12];			// Տ ()
+	PieceNumber_t komano[16*12];		// Տ (ԍ)
+	int8_t pin[16*10];				// s(ƌ藼p)
+	Bitboard byPieceBB[GRY+1];			// Տ̋̈ʒu [(㍞)]
+	Bitboard byColorBB[2];				// Տ̋̈ʒu []
+	Bitboard occupiedBB;				// ̂ʒu
+#define MAX_KOMANO	40
+	effect_t effect[2][16*12];				// 
+#define effectB	effect[BLACK]
+#define effectW	effect[WHITE]
+
+#define IsCheckS()	EXIST_EFFECT(effectW[kingS])	/* ʂɉ肪Ă邩? */
+#define IsCheckG()	EXIST_EFFECT(effectB[kingG])	/* ʂɉ肪Ă邩? */
 
 #endif
 
@@ -535,16 +634,16 @@ private:
 	StateInfo startState;
 	int64_t nodes;
 	int startPosPly;
-	Color sideToMove;		// Ԃ̐F
+#if !defined(NANOHA)
+	Color sideToMove;
+#endif
 	int threadID;
 #if defined(NANOHA)
 	int64_t tnodes;
-	unsigned long count_Mate1plyDrop;		// łŋl񂾉
-	unsigned long count_Mate1plyMove;		// ړŋl񂾉
-	unsigned long count_Mate3ply;			// Mate3()ŋl񂾉
-#endif
+	StateInfo* repHead[REP_BUCKETS];	// oPbgƂ̈ԐV StateInfo
+	bool repReady;						// repHead Ă邩 (Rs[͍ŏ do_move ō)
+#else
 	StateInfo* st;
-#if !defined(NANOHA)
 	int chess960;
 #endif
 
@@ -552,6 +651,7 @@ private:
 #if defined(NANOHA)
 //  static Key zobrist[2][RY+1][0x100];
 	static Key zobrist[GRY+1][0x100];
+	static Key zobHand[2][HI+1][19];	// [][][n] nȂ1`nڂ̍Sxor
 #else
 	static Score pieceSquareTable[16][64]; // [piece][square]
 	static Key zobrist[2][8][64];          // [color][pieceType][square]
@@ -596,23 +696,11 @@ inline void Position::set_tnodes_searched(int64_t n) {
 	tnodes = n;
 }
 
-#if defined(CHK_PERFORM)
-inline unsigned long Position::mate3_searched() const {
-	return count_Mate3ply;
-}
-inline void Position::set_mate3_searched(unsigned long  n) {
-	count_Mate3ply = n;
-}
-inline void Position::inc_mate3_searched(unsigned long  n) {
-	count_Mate3ply += n;
-}
-#endif // defined(CHK_PERFORM)
-
 #endif
 
 inline Piece Position::piece_on(Square s) const {
 #if defined(NANOHA)
-	return ban[s];
+	return Piece(ban[s]);
 #else
 	return board[s];
 #endif
@@ -901,54 +989,218 @@ inline int Position::SkipOverEMP(int pos, const int dir) const {
 	return pos + dir;
 }
 
+// rbg{[h
+inline Bitboard Position::occupied_squares() const {
+	return occupiedBB;
+}
+
+inline Bitboard Position::empty_squares() const {
+	return ~occupiedBB;
+}
+
+inline Bitboard Position::pieces(Color c) const {
+	return byColorBB[c];
+}
+
+inline Bitboard Position::pieces(Piece p) const {
+	return byPieceBB[p];
+}
+
+inline void Position::xor_piece_bb(const Piece p, const int z)
+{
+	byPieceBB[p].toggle(z);
+	byColorBB[color_of(p)].toggle(z);
+	occupiedBB.toggle(z);
+}
+
+inline Bitboard Position::pawn_files(const Color us) const
+{
+	return FileFillBB(byPieceBB[(us == BLACK) ? SFU : GFU]);
+}
+
+inline Bitboard Position::drop_squares(const Color us, const PieceType pt) const
+{
+	Bitboard b = empty_squares();
+	if (pt == FU) {
+		b &= ~pawn_files(us);
+	}
+	if (pt == FU || pt == KY) {
+		b &= (us == BLACK) ? RankRangeBB(2, 9) : RankRangeBB(1, 8);
+	} else if (pt == KE) {
+		b &= (us == BLACK) ? RankRangeBB(3, 9) : RankRangeBB(1, 7);
+	}
+	return b;
+}
+
+// ʐ錾p̓Gw̋𐔂(ǖʂ̐ݒ莞)
+inline void Position::init_camp()
+{
+	for (int c = BLACK; c <= WHITE; c++) {
+		int big;
+		st->campPieces[c] = uint8_t(count_in_enemy_camp(Color(c), big));
+		st->campBig[c] = uint8_t(big);
+	}
+}
+
+// GwOiڈȓ
+inline bool Position::in_enemy_camp(const Color us, const int z)
+{
+	return (us == BLACK) ? ((z & 0x0F) <= 3) : ((z & 0x0F) >= 7);
+}
+
+// Gw̋ p ̐ d (ʂ͐Ȃ)
+inline void Position::add_camp(const Color us, const Piece p, const int d)
+{
+	st->campPieces[us] = uint8_t(st->campPieces[us] + d);
+	if ((p & 0x06) == 0x06) st->campBig[us] = uint8_t(st->campBig[us] + d);	// pn
+}
+
+inline int Position::count_in_enemy_camp(const Color us, int &big) const
+{
+	const int SorG = (us == BLACK) ? SENTE : GOTE;
+	const Bitboard camp = EnemyCampBB(us);
+	big = ((byPieceBB[SorG|KA] | byPieceBB[SorG|HI] | byPieceBB[SorG|UM] | byPieceBB[SorG|RY]) & camp).count();
+	return (byColorBB[us] & ~byPieceBB[SorG|OU] & camp).count();
+}
+
+// EsOɌ̒lL^
+inline void Position::log_effect(const int c, const int z)
+{
+	const int n = st->nEffectLog++;
+	if (n < EFFECT_LOG_MAX) {
+		st->effectLog[n].value = effect[c][z];
+		st->effectLog[n].c = uint8_t(c);
+		st->effectLog[n].z = uint8_t(z);
+	}
+}
+
+inline void Position::log_pin(const int z)
+{
+	const int n = st->nPinLog++;
+	if (n < PIN_LOG_MAX) {
+		st->pinLog[n].z = uint8_t(z);
+		st->pinLog[n].dir = int8_t(pin[z]);
+	}
+}
+
+// ׂ݂̗̎ĎcĂ邩
+inline bool Position::effect_logged() const
+{
+	return st->nEffectLog <= EFFECT_LOG_MAX && st->nPinLog <= PIN_LOG_MAX;
+}
+
+inline void Position::restore_effect_log()
+{
+	for (int i = st->nPinLog; i-- > 0; ) {
+		pin[st->pinLog[i].z] = st->pinLog[i].dir;
+	}
+	for (int i = st->nEffectLog; i-- > 0; ) {
+		const EffectLog &e = st->effectLog[i];
+		effect[e.c][e.z] = e.value;
+	}
+}
+
+inline void Position::do_move(Move m, StateInfo& newSt)
+{
+	if (side_to_move() == BLACK) do_move<BLACK>(m, newSt);
+	else                         do_move<WHITE>(m, newSt);
+}
+
+// ߂Ƃ̎Ԃ͎w(̎Ԃ̑)
+inline void Position::undo_move(Move m)
+{
+	if (side_to_move() == WHITE) undo_move<BLACK>(m);
+	else                         undo_move<WHITE>(m);
+}
+
+// do_move()  st->key  st->effect ܂ɁAǖʂTėɉ
+inline void Position::push_repetition(const Color us)
+{
+	StateInfo*& head = repHead[st->key & (REP_BUCKETS - 1)];
+	if (!repReady)
+		init_repetition(st->previous);
+	StateInfo* p = head;
+	st->ply = st->previous->ply + 1;
+	while (p && st->ply - p->ply <= st->pliesFromNull && p->key != st->key)
+		p = p->bucketPrev;
+	st->sameKey = (p && st->ply - p->ply <= st->pliesFromNull) ? p : NULL;
+	st->repetition = st->sameKey ? st->sameKey->repetition + 1 : 0;
+	st->checkRun[us] = st->effect ? st->previous->checkRun[us] + 1 : 0;
+	st->checkRun[flip(us)] = st->previous->checkRun[flip(us)];
+	st->bucketPrev = head;
+	head = st;
+}
+
+inline void Position::pop_repetition()
+{
+	repHead[st->key & (REP_BUCKETS - 1)] = st->bucketPrev;
+}
+
+inline int Position::hand_piece_number(const Color us, const int pt) const
+{
+	static const int kns[HI+1] = {0, KNS_FU, KNS_KY, KNS_KE, KNS_GI, KNS_KI, KNS_KA, KNS_HI};
+	static const int kne[HI+1] = {0, KNE_FU, KNE_KY, KNE_KE, KNE_GI, KNE_KI, KNE_KA, KNE_HI};
+	const int h = (us == BLACK) ? 1 : 2;
+	int kn = kns[pt];
+	while (kn <= kne[pt] && knpos[kn] != h) kn++;
+	return kn;
+}
+
 // `FbN(true:pos̋؂ɕ遁ɂȂAfalse:pos̋؂ɕȂ)
 inline bool Position::is_double_pawn(const Color us, const int pos) const
 {
-	const Piece *p = &(ban[(pos & ~0x0F)+1]);
-	Piece pawn = (us == BLACK) ? SFU : GFU;
-	for (int i = 0; i < 9; i++) {
-		if (*p++ == pawn) {
-			return true;
-		}
-	}
-	return false;
+	return (byPieceBB[(us == BLACK) ? SFU : GFU] & FileBB(pos >> 4)).any();
 }
 
 // ֘A
+// ї̓͂Ō̈ʒu(ŏ̋ՊOB͑ʂт)
+template<Color turn>
+inline int Position::ray_end(const int z, const int dir) const
+{
+	const int enemyKing = (turn == BLACK) ? GOU : SOU;
+	const int end = SkipOverEMP(z, dir);
+	return (ban[end] == enemyKing && ban[end + dir] != WALL) ? end + dir : end;
+}
+
+// ɗ͈̓͂͂߂ĂAO effect[] ܂Ƃ߂ďB
+// ban[] ̓ǂݍ݂ effect[] ݂݂̏ɂȂȂ̂ŁA[vグɂȂB
 template<Color turn>
 inline void Position::add_effect_straight(const int z, const int dir, const uint32_t bit)
 {
+	const int end = ray_end<turn>(z, dir);
+	effect_t *e = effect[turn];
+	int n = st->nEffectLog;
 	int zz = z;
 	do {
 		zz += dir;
-		effect[turn][zz] |= bit;
-	} while(ban[zz] == EMP);
-
-	// ͑ʂт
-	const int enemyKing = (turn == BLACK) ? GOU : SOU;
-	if (ban[zz] == enemyKing) {
-		zz += dir;
-		if (ban[zz] != WALL) {
-			effect[turn][zz] |= bit;
+		if (n < EFFECT_LOG_MAX) {
+			st->effectLog[n].value = e[zz];
+			st->effectLog[n].c = uint8_t(turn);
+			st->effectLog[n].z = uint8_t(zz);
 		}
-	}
+		n++;
+		e[zz] |= bit;
+	} while (zz != end);
+	st->nEffectLog = n;
 }
 template<Color turn>
 inline void Position::del_effect_straight(const int z, const int dir, const uint32_t bit)
 {
+	const int end = ray_end<turn>(z, dir);
+	effect_t *e = effect[turn];
+	int n = st->nEffectLog;
 	int zz = z;
 	do {
-		zz += dir; effect[turn][zz] &= bit;
-	} while(ban[zz] == EMP);
-
-	// ͑ʂт
-	const int enemyKing = (turn == BLACK) ? GOU : SOU;
-	if (ban[zz] == enemyKing) {
 		zz += dir;
-		if (ban[zz] != WALL) {
-			effect[turn][zz] &= bit;
+		if (n < EFFECT_LOG_MAX) {
+			st->effectLog[n].value = e[zz];
+			st->effectLog[n].c = uint8_t(turn);
+			st->effectLog[n].z = uint8_t(zz);
 		}
-	}
+		n++;
+		e[zz] &= bit;
+	} while (zz != end);
+	st->nEffectLog = n;
 }
 
 // sXV
@@ -961,7 +1213,10 @@ inline void Position::add_pin_info(const int dir) {
 		if ((turn == BLACK && (ban[z] & GOTE) == 0)
 		 || (turn == WHITE && (ban[z] & GOTE) != 0)) {
 			effect_t eft = (turn == BLACK) ? EFFECT_KING_S(z) : EFFECT_KING_G(z);
-			if (eft & (effect[rturn][z] >> EFFECT_LONG_SHIFT)) pin[z] = dir;
+			if (eft & (effect[rturn][z] >> EFFECT_LONG_SHIFT)) {
+				log_pin(z);
+				pin[z] = dir;
+			}
 		}
 	}
 }
@@ -972,6 +1227,7 @@ void Position::del_pin_info(const int dir) {
 	if (ban[z] != WALL) {
 		if ((turn == BLACK && (ban[z] & GOTE) == 0)
 		 || (turn == WHITE && (ban[z] & GOTE) != 0)) {
+			log_pin(z);
 			pin[z] = 0;
 		}
 	}
@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "position.h"
+#include "posfile.h"
 #include "search.h"
 #include "ucioption.h"
 #if defined(NANOHA)
@@ -102,7 +103,7 @@ const string ComShogi[] = {
 }
 
 void solve_problem(int argc, char* argv[]) {
-	vector<string> sfenList;
+	PositionReader sfenList;
 	SearchLimits limits;
 	int time;
 
@@ -191,29 +192,14 @@ void solve_problem(int argc, char* argv[]) {
 	// Do we need to load positions from a given SFEN file ?
 	if (sfenFile != "default")
 	{
-		// t@Cw肳ꂽ
-		string fen;
-		ifstream f(sfenFile.c_str());
-
-		if (!f.is_open())
+		// t@Cw肳ꂽ(SFEN eLXgǖʃt@C)
+		if (!sfenList.open(sfenFile))
 		{
 			cerr << "Unable to open file " << sfenFile << endl;
 			exit(EXIT_FAILURE);
 		}
-
-		while (getline(f, fen)) {
-			if (!fen.empty()) {
-				if (fen.compare(0, 5, "sfen ") == 0) {
-					fen.erase(0, 5);
-				}
-				sfenList.push_back(fen);
-			}
-		}
-		f.close();
 	} else {
-		for (int i = 0; !ComShogi[i].empty(); i++) {
-			sfenList.push_back(ComShogi[i]);
-		}
+		sfenList.open(ComShogi);
 	}
 
 	// t@Co͂H
@@ -228,8 +214,10 @@ void solve_problem(int argc, char* argv[]) {
 		}
 		if (sfenFile != "default") {
 			prefix = sfenFile;
-			size_t npos = prefix.rfind(".sfen");
-			prefix.replace(npos, 5, "");
+			size_t npos = prefix.rfind('.');
+			if (npos != string::npos && prefix.find_first_of("/\\", npos) == string::npos) {
+				prefix.erase(npos);
+			}
 		} else {
 			prefix = "ComShogi";
 		}
@@ -250,10 +238,10 @@ void solve_problem(int argc, char* argv[]) {
 	int64_t totalTNodes = 0;
 	time = get_system_time();
 
-	for (size_t i = 0; i < sfenList.size(); i++)
+	Position pos(ComShogi[0], 0);
+	for (size_t i = 0; sfenList.next(pos); i++)
 	{
 		Move moves[MAX_MOVES] = { MOVE_NONE };
-		Position pos(sfenList[i], 0);
 
 		int rap_time = get_system_time();
 		cerr << "\nBench position: " << i + 1 << '/' << sfenList.size() << endl;
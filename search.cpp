@@ -504,11 +504,17 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
 
 	// Set a new TT size if changed
 	TT.set_size(Options["Hash"].value<int>());
+#if defined(NANOHA)
+	EvalHash.set_size(Options["EvalHash"].value<int>());
+#endif
 
 	if (Options["Clear Hash"].value<bool>())
 	{
 		Options["Clear Hash"].set_value("false");
 		TT.clear();
+#if defined(NANOHA)
+		EvalHash.clear();
+#endif
 	}
 
 	// Do we have to play with skill handicap? In this case enable MultiPV that
@@ -522,6 +528,16 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
 		Threads[i].wake_up();
 		Threads[i].maxPly = 0;
 	}
+#if defined(NANOHA)
+	for (int i = 0; i < MAX_THREADS; i++)
+	{
+		Threads[i].evalHashProbes = Threads[i].evalHashHits = Threads[i].searchedNodes = 0;
+		Threads[i].splitCopies = Threads[i].splitCopyTicks = 0;
+#if defined(CHK_PERFORM)
+		Threads[i].mate1plyDrops = Threads[i].mate1plyMoves = Threads[i].mate3plyMates = 0;
+#endif
+	}
+#endif
 
 	// Write to log file and keep it open to be accessed during the search
 	if (Options["Use Search Log"].value<bool>())
@@ -539,10 +555,21 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
 			        << endl;
 	}
 
+#if defined(NANOHA)
+	// All the threads use the evaluation tables current at this point until the
+	// end of the search, even if evalreload swaps them meanwhile.
+	eval_search_begin(pos);
+#endif
+
 	// We're ready to start thinking. Call the iterative deepening loop function
 	Move ponderMove = MOVE_NONE;
 	Move bestMove = id_loop(pos, searchMoves, &ponderMove);
 
+#if defined(NANOHA)
+	eval_search_end();
+	Threads[pos.thread()].searchedNodes += pos.nodes_searched();
+#endif
+
 	// Write final search statistics and close log file
 	if (LogFile.is_open())
 	{
@@ -559,6 +586,19 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
 		LogFile.close();
 	}
 
+#if defined(NANOHA)
+	if (EvalHash.entry_count())
+	{
+		int64_t probes, hits;
+		eval_hash_stats(&probes, &hits);
+		cout << "info string evalhash " << EvalHash.mb_size() << "MB"
+		     << " entries " << EvalHash.entry_count()
+		     << " probes " << probes
+		     << " hits " << hits
+		     << " (" << (probes ? hits * 1000 / probes : 0) / 10.0 << "%)" << endl;
+	}
+#endif
+
 	// This makes all the threads to go to sleep
 	Threads.set_size(1);
 
@@ -595,6 +635,21 @@ bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]) {
 	return !QuitRequest;
 }
 
+#if defined(NANOHA)
+/// eval_hash_stats() sums the evaluation cache counters of all the threads
+/// since the last call to think().
+
+void eval_hash_stats(int64_t* probes, int64_t* hits) {
+
+	*probes = *hits = 0;
+	for (int i = 0; i < MAX_THREADS; i++)
+	{
+		*probes += Threads[i].evalHashProbes;
+		*hits += Threads[i].evalHashHits;
+	}
+}
+#endif
+
 
 namespace {
 
@@ -937,7 +992,7 @@ namespace {
 		excludedMove = ss->excludedMove;
 #if defined(NANOHA)
 		posKey = excludedMove != MOVE_NONE ? pos.get_exclusion_key() : pos.get_key();
-		tte = TT.probe(posKey, pos.handValue_of_side());
+		tte = TT.probe(posKey);
 #else
 		posKey = excludedMove ? pos.get_exclusion_key() : pos.get_key();
 		tte = TT.probe(posKey);
@@ -984,9 +1039,7 @@ namespace {
 		else
 		{
 			refinedValue = ss->eval = evaluate(pos, ss->evalMargin);
-#if defined(NANOHA)
-			TT.store(posKey, pos.handValue_of_side(), VALUE_NONE, VALUE_TYPE_NONE, DEPTH_NONE, MOVE_NONE, ss->eval, ss->evalMargin);
-#else
+#if !defined(NANOHA)
 			TT.store(posKey, VALUE_NONE, VALUE_TYPE_NONE, DEPTH_NONE, MOVE_NONE, ss->eval, ss->evalMargin);
 #endif
 		}
@@ -1146,11 +1199,7 @@ namespace {
 			search<PvNode ? PV : NonPV>(pos, ss, alpha, beta, d);
 			ss->skipNullMove = false;
 
-#if defined(NANOHA)
-			tte = TT.probe(posKey, pos.handValue_of_side());
-#else
 			tte = TT.probe(posKey);
-#endif
 		}
 
 split_point_start: // At split points actual search starts from here
@@ -1501,11 +1550,7 @@ split_point_start: // At split points actual search starts from here
 			vt   = bestValue <= oldAlpha ? VALUE_TYPE_UPPER
 			     : bestValue >= beta ? VALUE_TYPE_LOWER : VALUE_TYPE_EXACT;
 
-#if defined(NANOHA)
-			TT.store(posKey, pos.handValue_of_side(), value_to_tt(bestValue, ss->ply), vt, depth, move, ss->eval, ss->evalMargin);
-#else
 			TT.store(posKey, value_to_tt(bestValue, ss->ply), vt, depth, move, ss->eval, ss->evalMargin);
-#endif
 
 			// Update killers and history only for non capture moves that fails high
 			if (    bestValue >= beta
@@ -1530,6 +1575,9 @@ split_point_start: // At split points actual search starts from here
 			// Here we have the lock still grabbed
 			sp->is_slave[pos.thread()] = false;
 			sp->nodes += pos.nodes_searched();
+#if defined(NANOHA)
+			Threads[pos.thread()].searchedNodes += pos.nodes_searched();
+#endif
 			lock_release(&(sp->lock));
 		}
 
@@ -1612,11 +1660,7 @@ split_point_start: // At split points actual search starts from here
 
 		// Transposition table lookup. At PV nodes, we don't use the TT for
 		// pruning, but only for move ordering.
-#if defined(NANOHA)
-		tte = TT.probe(pos.get_key(), pos.handValue_of_side());
-#else
 		tte = TT.probe(pos.get_key());
-#endif
 		ttMove = (tte ? tte->move() : MOVE_NONE);
 
 		if (!PvNode && tte && can_return_tt(tte, ttDepth, beta, ss->ply))
@@ -1650,11 +1694,7 @@ split_point_start: // At split points actual search starts from here
 			if (bestValue >= beta)
 			{
 				if (!tte)
-#if defined(NANOHA)
-					TT.store(pos.get_key(), pos.handValue_of_side(), value_to_tt(bestValue, ss->ply), VALUE_TYPE_LOWER, DEPTH_NONE, MOVE_NONE, ss->eval, evalMargin);
-#else
 					TT.store(pos.get_key(), value_to_tt(bestValue, ss->ply), VALUE_TYPE_LOWER, DEPTH_NONE, MOVE_NONE, ss->eval, evalMargin);
-#endif
 
 				return bestValue;
 			}
@@ -1823,11 +1863,7 @@ split_point_start: // At split points actual search starts from here
 		vt   = bestValue <= oldAlpha ? VALUE_TYPE_UPPER
 		     : bestValue >= beta ? VALUE_TYPE_LOWER : VALUE_TYPE_EXACT;
 
-#if defined(NANOHA)
-		TT.store(pos.get_key(), pos.handValue_of_side(), value_to_tt(bestValue, ss->ply), vt, ttDepth, move, ss->eval, evalMargin);
-#else
 		TT.store(pos.get_key(), value_to_tt(bestValue, ss->ply), vt, ttDepth, move, ss->eval, evalMargin);
-#endif
 
 		assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -2366,8 +2402,24 @@ split_point_start: // At split points actual search starts from here
 				if (StopOnPonderhit)
 					StopRequest = true;
 			}
+#if defined(NANOHA)
+			else if (command.find("evalreload") == 0)
+			{
+				// Load new evaluation tables in the background, the current search
+				// keeps the old ones and the next one starts with the new ones.
+				string name = command.substr(std::min(command.size(), size_t(11)));
+				if (!name.empty())
+					Options["EvalFile"].set_value(name);
+				if (!start_eval_reload(Options["EvalFile"].value<string>(), true))
+					cout << "info string EvalFile reload already in progress" << endl;
+			}
+#endif
 		}
 
+#if defined(NANOHA)
+		poll_eval_reload(false);
+#endif
+
 		// Print search information
 		if (t < 1000)
 			lastInfoTime = 0;
@@ -2548,7 +2600,7 @@ split_point_start: // At split points actual search starts from here
 
 #if defined(NANOHA)
 		int dummy = 0;
-		while (   (tte = TT.probe(pos.get_key(), pos.handValue_of_side())) != NULL
+		while (   (tte = TT.probe(pos.get_key())) != NULL
 #else
 		while (   (tte = TT.probe(pos.get_key())) != NULL
 #endif
@@ -2591,21 +2643,13 @@ split_point_start: // At split points actual search starts from here
 
 		do {
 			k = pos.get_key();
-#if defined(NANOHA)
-			tte = TT.probe(k, pos.handValue_of_side());
-#else
 			tte = TT.probe(k);
-#endif
 
 			// Don't overwrite existing correct entries
 			if (!tte || tte->move() != pv[ply])
 			{
 				v = (pos.in_check() ? VALUE_NONE : evaluate(pos, m));
-#if defined(NANOHA)
-				TT.store(k, pos.handValue_of_side(), VALUE_NONE, VALUE_TYPE_NONE, DEPTH_NONE, pv[ply], v, m);
-#else
 				TT.store(k, VALUE_NONE, VALUE_TYPE_NONE, DEPTH_NONE, pv[ply], v, m);
-#endif
 			}
 			pos.do_move(pv[ply], *st++);
 
@@ -2677,10 +2721,25 @@ void Thread::idle_loop(SplitPoint* sp) {
 		{
 			assert(!do_terminate);
 
+#if defined(NANOHA)
+			if (boundNode != numaNode)
+			{
+				numa_bind_self(numaNode);
+				boundNode = numaNode;
+			}
+#endif
+
 			// Copy split point position and search stack and call search()
 			SearchStack ss[PLY_MAX_PLUS_2];
 			SplitPoint* tsp = splitPoint;
+#if defined(NANOHA)
+			const uint64_t copyStart = cpu_ticks();
+#endif
 			Position pos(*tsp->pos, threadID);
+#if defined(NANOHA)
+			splitCopyTicks += cpu_ticks() - copyStart;
+			splitCopies++;
+#endif
 
 			memcpy(ss, tsp->ss - 1, 4 * sizeof(SearchStack));
 			(ss+1)->sp = tsp;
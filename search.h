@@ -71,5 +71,8 @@ struct SearchLimits {
 extern void init_search();
 extern int64_t perft(Position& pos, Depth depth);
 extern bool think(Position& pos, const SearchLimits& limits, Move searchMoves[]);
+#if defined(NANOHA)
+extern void eval_hash_stats(int64_t* probes, int64_t* hits);
+#endif
 
 #endif // !defined(SEARCH_H_INCLUDED)
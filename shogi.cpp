@@ -27,6 +27,7 @@
 #include "position.h"
 #include "tt.h"
 #include "book.h"
+#include "thread.h"
 #include "ucioption.h"
 #if defined(EVAL_MICRO)
 #include "param_micro.h"
@@ -42,6 +43,12 @@
 const uint32_t Hand::tbl[HI+1] = {
 	0, HAND_FU_INC, HAND_KY_INC, HAND_KE_INC, HAND_GI_INC, HAND_KI_INC, HAND_KA_INC, HAND_HI_INC, 
 };
+const uint32_t Hand::mask[HI+1] = {
+	0, HAND_FU_MASK, HAND_KY_MASK, HAND_KE_MASK, HAND_GI_MASK, HAND_KI_MASK, HAND_KA_MASK, HAND_HI_MASK, 
+};
+const int Hand::shift[HI+1] = {
+	0, HAND_FU_SHIFT, HAND_KY_SHIFT, HAND_KE_SHIFT, HAND_GI_SHIFT, HAND_KI_SHIFT, HAND_KA_SHIFT, HAND_HI_SHIFT, 
+};
 #if defined(ENABLE_MYASSERT)
 int debug_level;
 #endif
@@ -221,17 +228,36 @@ int foutput_log(FILE *fp, const char *fmt, ...)
 	return ret;
 }
 
+namespace {
+	// ]xNgƒՂ̓ǂݍ݂͎Ԃ̂ŁANɕʃXbhŎn߂
+	// wait_application_init() ő҂
+	HelperThread initEval, initBook;
+	std::string initBookFile;
+	bool initPending = false;
+
+	void init_eval_task(void *)
+	{
+		Position::init_evaluate();	// ]xNg̓ǂݍ
+	}
+
+	void init_book_task(void *)
+	{
+		book->open(initBookFile);	// Ճt@C̓ǂݍ
+	}
+}
+
 // st@CNɍs.
 void init_application_once()
 {
-	Position::init_evaluate();	// ]xNg̓ǂݍ
 	Position::initMate1ply();
 
-// Ճt@C̓ǂݍ
+	initEval.start(init_eval_task, NULL);
 	if (book == NULL) {
 		book = new Book();
-		book->open(Options["BookFile"].value<std::string>());
+		initBookFile = Options["BookFile"].value<std::string>();
+		initBook.start(init_book_task, NULL);
 	}
+	initPending = true;
 
 	int from;
 	int to;
@@ -252,6 +278,15 @@ void init_application_once()
 	}
 }
 
+// init_application_once() Ŏn߂ǂݍ݂Î҂.
+void wait_application_init()
+{
+	if (!initPending) return;
+	initEval.join();
+	initBook.join();
+	initPending = false;
+}
+
 // ֌W
 void Position::init_position(const unsigned char board_ori[9][9], const int Mochigoma_ori[])
 {
@@ -286,6 +321,10 @@ void Position::init_position(const unsigned char board_ori[9][9], const int Moch
 	memset(komano, 0, sizeof(komano));
 	memset(knkind, 0, sizeof(knkind));
 	memset(knpos,  0, sizeof(knpos));
+	for (i = 0; i < sizeof(byPieceBB)/sizeof(byPieceBB[0]); i++) {
+		byPieceBB[i] = EmptyBB();
+	}
+	byColorBB[BLACK] = byColorBB[WHITE] = occupiedBB = EmptyBB();
 
 	// boardŗ^ꂽǖʂݒ肵܂B
 	int z;
@@ -364,6 +403,7 @@ void Position::init_position(const unsigned char board_ori[9][9], const int Moch
 #undef KNABORT
 #undef KNSET
 
+			if (ban[z] != EMP) xor_piece_bb(Piece(ban[z]), z);
 		}
 	}
 
@@ -484,7 +524,7 @@ void Position::init_effect()
 
 void Position::add_effect(const int z)
 {
-#define ADD_EFFECT(turn,dir) zz = z + DIR_ ## dir; effect[turn][zz] |= EFFECT_ ## dir;
+#define ADD_EFFECT(turn,dir) zz = z + DIR_ ## dir; log_effect(turn, zz); effect[turn][zz] |= EFFECT_ ## dir;
 
 	int zz;
 
@@ -628,7 +668,7 @@ void Position::add_effect(const int z)
 
 void Position::del_effect(const int z, const Piece kind)
 {
-#define DEL_EFFECT(turn,dir) zz = z + DIR_ ## dir; effect[turn][zz] &= ~(EFFECT_ ## dir);
+#define DEL_EFFECT(turn,dir) zz = z + DIR_ ## dir; log_effect(turn, zz); effect[turn][zz] &= ~(EFFECT_ ## dir);
 
 	int zz;
 	switch (kind) {
@@ -778,6 +818,7 @@ void Position::del_effect(const int z, const Piece kind)
 /// to a StateInfo object. The move is assumed to be legal. Pseudo-legal
 /// moves should be filtered out before this function is called.
 
+template<Color us>
 void Position::do_move(Move m, StateInfo& newSt)
 {
 	assert(is_ok());
@@ -801,6 +842,8 @@ void Position::do_move(Move m, StateInfo& newSt)
 		Piece captured;
 		uint32_t hand;
 		uint32_t effect;
+		uint8_t campPieces[2];
+		uint8_t campBig[2];
 		Key key;
 	};
 
@@ -808,6 +851,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 
 	newSt.previous = st;
 	st = &newSt;
+	st->nEffectLog = st->nPinLog = 0;
 
 	// Update side to move
 	key ^= zobSideToMove;
@@ -816,13 +860,13 @@ void Position::do_move(Move m, StateInfo& newSt)
 	// case of non-reversible moves is taken care of later.
 	st->pliesFromNull++;
 
-	const Color us = side_to_move();
 	if (move_is_drop(m))
 	{
 		st->key = key;
-		do_drop(m);
+		do_drop<us>(m);
 		st->hand = hand[us].h;
 		st->effect = (us == BLACK) ? effectB[kingG] : effectW[kingS];
+		push_repetition(us);
 		assert(!at_checking());
 		assert(get_key() == compute_key());
 		return;
@@ -842,7 +886,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 	assert(color_of(piece_on(to)) == them || square_is_empty(to));
 
 	// s̃NA
-	if (piece == SOU) {
+	if (us == BLACK && piece == SOU) {
 		// ʂ𓮂
 		DelPinInfS(DIR_UP);
 		DelPinInfS(DIR_DOWN);
@@ -856,7 +900,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 			_BitScanForward(&id, EFFECT_KING_G(to));
 			DelPinInfG(NanohaTbl::Direction[id]);
 		}
-	} else if (piece == GOU) {
+	} else if (us == WHITE && piece == GOU) {
 		// ʂ𓮂
 		DelPinInfG(DIR_UP);
 		DelPinInfG(DIR_DOWN);
@@ -876,6 +920,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 			if (EFFECT_KING_S(from)) {
 ///				_BitScanForward(&id, EFFECT_KING_S(from));
 ///				DelPinInfS(NanohaTbl::Direction[id]);
+				log_pin(from);
 				pin[from] = 0;
 			}
 			if (EFFECT_KING_S(to)/* && (effectW[to] & EFFECT_LONG_MASK)*/) {
@@ -913,6 +958,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 			if (EFFECT_KING_G(from)) {
 //				_BitScanForward(&id, EFFECT_KING_G(from));
 //				DelPinInfG(NanohaTbl::Direction[id]);
+				log_pin(from);
 				pin[from] = 0;
 			}
 			if (EFFECT_KING_G(to)/* && (effectB[to] & EFFECT_LONG_MASK)*/) {
@@ -930,6 +976,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 		knpos[kn] = (us == BLACK) ? 1 : 2;
 		if (us == BLACK) handS.inc(capture & ~(GOTE | PROMOTED));
 		else             handG.inc(capture & ~(GOTE | PROMOTED));
+		key ^= zobHand[us][capture & ~(GOTE | PROMOTED)][hand[us].get(capture & ~(GOTE | PROMOTED))];
 
 #if !defined(TSUMESOLVER)
 		// material XV
@@ -938,6 +985,8 @@ void Position::do_move(Move m, StateInfo& newSt)
 
 		// nbVXV
 		key ^= zobrist[capture][to];
+
+		if (in_enemy_camp(flip(us), to)) add_camp(flip(us), capture, -1);
 	} else {
 		// ړ͋󁨈ړ̒
 		// ̗
@@ -958,6 +1007,11 @@ void Position::do_move(Move m, StateInfo& newSt)
 		}
 	}
 
+	// ʐ錾p̓Gw̋
+	if (piece != (us == BLACK ? SOU : GOU) && in_enemy_camp(us, from) != in_enemy_camp(us, to)) {
+		add_camp(us, piece, in_enemy_camp(us, to) ? 1 : -1);
+	}
+
 	kn = komano[from];
 	if (pm) {
 #if !defined(TSUMESOLVER)
@@ -977,6 +1031,9 @@ void Position::do_move(Move m, StateInfo& newSt)
 	prefetch(reinterpret_cast<char*>(TT.first_entry(key)));
 
 	// Move the piece
+	if (capture) xor_piece_bb(capture, to);
+	xor_piece_bb(Piece(ban[from]), from);
+	xor_piece_bb(piece, to);
 
 	ban[to]   = piece;
 	ban[from] = EMP;
@@ -1005,7 +1062,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 	}
 
 	// s̕t
-	if (piece == SOU) {
+	if (us == BLACK && piece == SOU) {
 		AddPinInfS(DIR_UP);
 		AddPinInfS(DIR_DOWN);
 		AddPinInfS(DIR_RIGHT);
@@ -1022,7 +1079,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 			_BitScanForward(&id, EFFECT_KING_G(to));
 			AddPinInfG(NanohaTbl::Direction[id]);
 		}
-	} else if (piece == GOU) {
+	} else if (us == WHITE && piece == GOU) {
 		AddPinInfG(DIR_UP);
 		AddPinInfG(DIR_DOWN);
 		AddPinInfG(DIR_RIGHT);
@@ -1058,6 +1115,9 @@ void Position::do_move(Move m, StateInfo& newSt)
 		}
 	}
 
+	// ]֐̍
+	set_eval_diff(pm ? Piece(piece & ~PROMOTED) : piece, from, piece, to, capture);
+
 	// Set capture piece
 	st->captured = capture;
 
@@ -1065,6 +1125,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 	st->key = key;
 	st->hand = hand[us].h;
 	st->effect = (us == BLACK) ? effectB[kingG] : effectW[kingS];
+	push_repetition(us);
 
 #if !defined(NDEBUG)
 	// wƂɁAɂȂĂˎEɂȂĂ
@@ -1076,7 +1137,7 @@ void Position::do_move(Move m, StateInfo& newSt)
 #endif
 
 	// Finish
-	sideToMove = flip(sideToMove);
+	sideToMove = flip(us);
 
 #if defined(MOVE_TRACE)
 	int fail;
@@ -1090,9 +1151,9 @@ void Position::do_move(Move m, StateInfo& newSt)
 	assert(get_key() == compute_key());
 }
 
+template<Color us>
 void Position::do_drop(Move m)
 {
-	const Color us = side_to_move();
 	const Square to = move_to(m);
 
 	assert(square_is_empty(to));
@@ -1174,6 +1235,8 @@ void Position::do_drop(Move m)
 		break;
 	}
 
+	// ̃nbV͌O̖̍O
+	st->key ^= zobHand[us][piece & ~GOTE][hand[us].get(piece & ~GOTE)];
 	if (us == BLACK) {
 		handS.h -= diff;
 		while (kn <= kne) {
@@ -1202,6 +1265,8 @@ void Position::do_drop(Move m)
 	knpos[kn] = to;
 	ban[to] = piece;
 	komano[to] = kn;
+	xor_piece_bb(piece, to);
+	if (in_enemy_camp(us, to)) add_camp(us, piece, 1);
 
 	// XV
 	add_effect(to);
@@ -1216,6 +1281,9 @@ void Position::do_drop(Move m)
 		AddPinInfG(NanohaTbl::Direction[id]);
 	}
 
+	// ]֐̍
+	set_eval_diff(piece, 0, piece, to, EMP);
+
 	// Set capture piece
 	st->captured = EMP;
 
@@ -1226,7 +1294,7 @@ void Position::do_drop(Move m)
 	prefetch(reinterpret_cast<char*>(TT.first_entry(st->key)));
 
 	// Finish
-	sideToMove = flip(sideToMove);
+	sideToMove = flip(us);
 
 	assert(is_ok());
 }
@@ -1234,6 +1302,7 @@ void Position::do_drop(Move m)
 /// Position::undo_move() unmakes a move. When it returns, the position should
 /// be restored to exactly the same state as before the move was made.
 
+template<Color us>
 void Position::undo_move(Move m) {
 
 #if defined(MOVE_TRACE)
@@ -1248,15 +1317,15 @@ void Position::undo_move(Move m) {
 #endif
 	assert(move_is_ok(m));
 
-	sideToMove = flip(sideToMove);
+	sideToMove = us;
+	pop_repetition();
 
 	if (move_is_drop(m))
 	{
-		undo_drop(m);
+		undo_drop<us>(m);
 		return;
 	}
 
-	Color us = side_to_move();
 	Square from = move_from(m);
 	Square to = move_to(m);
 	bool pm = is_promotion(m);
@@ -1269,8 +1338,41 @@ void Position::undo_move(Move m) {
 	assert(square_is_empty(from));
 	assert(color_of_piece_on(to) == us);
 
+	if (effect_logged()) {
+		// Ֆʂ߂Aƃs͋L^̒l߂
+		kn = komano[to];
+#if !defined(TSUMESOLVER)
+		// material XV
+		if (pm) material -= NanohaTbl::KomaValuePro[piece];
+		if (captured) material += NanohaTbl::KomaValueEx[captured];
+#endif//#if !defined(TSUMESOLVER)
+		knkind[kn] = piece;
+		knpos[kn] = from;
+		xor_piece_bb(Piece(ban[to]), to);
+		xor_piece_bb(piece, from);
+		ban[from] = piece;
+		komano[from] = kn;
+		ban[to] = captured;
+		if (captured) {
+			xor_piece_bb(captured, to);
+			kn = hand_piece_number(us, captured & ~(GOTE|PROMOTED));
+			knkind[kn] = captured;
+			knpos[kn] = to;
+			komano[to] = kn;
+			if (us == BLACK) handS.dec(captured & ~(GOTE | PROMOTED));
+			else             handG.dec(captured & ~(GOTE | PROMOTED));
+		} else {
+			komano[to] = 0;
+		}
+		restore_effect_log();
+
+		st = st->previous;
+		assert(is_ok());
+		return;
+	}
+
 	// s̃NA
-	if (piece == SOU) {
+	if (us == BLACK && piece == SOU) {
 		DelPinInfS(DIR_UP);
 		DelPinInfS(DIR_DOWN);
 		DelPinInfS(DIR_RIGHT);
@@ -1287,7 +1389,7 @@ void Position::undo_move(Move m) {
 			_BitScanForward(&id, EFFECT_KING_G(to));
 			DelPinInfG(NanohaTbl::Direction[id]);
 		}
-	} else if (piece == GOU) {
+	} else if (us == WHITE && piece == GOU) {
 		DelPinInfG(DIR_UP);
 		DelPinInfG(DIR_DOWN);
 		DelPinInfG(DIR_RIGHT);
@@ -1344,7 +1446,7 @@ void Position::undo_move(Move m) {
 		}
 	}
 
-	del_effect(to, ban[to]);					// ̗
+	del_effect(to, Piece(ban[to]));					// ̗
 
 	kn = komano[to];
 	if (pm) {
@@ -1358,6 +1460,10 @@ void Position::undo_move(Move m) {
 	knkind[kn] = piece;
 	knpos[kn] = from;
 
+	xor_piece_bb(Piece(ban[to]), to);
+	xor_piece_bb(piece, from);
+	if (captured) xor_piece_bb(captured, to);
+
 	ban[to] = captured;
 	komano[from] = komano[to];
 	ban[from] = piece;
@@ -1458,7 +1564,7 @@ void Position::undo_move(Move m) {
 			_BitScanForward(&id, tkiki);
 			tkiki &= tkiki-1;
 			DelKikiDirG(from, NanohaTbl::Direction[id], ~(1u << id));
-			if (piece == SOU) {
+			if (us == BLACK && piece == SOU) {
 				// ͋ʂт
 				if (ban[from + NanohaTbl::Direction[id]] != WALL) effectW[from + NanohaTbl::Direction[id]] |= (1u << id);
 			}
@@ -1470,7 +1576,7 @@ void Position::undo_move(Move m) {
 			_BitScanForward(&id, tkiki);
 			tkiki &= tkiki-1;
 			DelKikiDirS(from, NanohaTbl::Direction[id], ~(1u << id));
-			if (piece == GOU) {
+			if (us == WHITE && piece == GOU) {
 				// ͋ʂт
 				if (ban[from + NanohaTbl::Direction[id]] != WALL) effectB[from + NanohaTbl::Direction[id]] |= (1u << id);
 			}
@@ -1481,7 +1587,7 @@ void Position::undo_move(Move m) {
 	add_effect(from);
 
 	// st
-	if (piece == SOU) {
+	if (us == BLACK && piece == SOU) {
 		AddPinInfS(DIR_UP);
 		AddPinInfS(DIR_DOWN);
 		AddPinInfS(DIR_RIGHT);
@@ -1498,7 +1604,7 @@ void Position::undo_move(Move m) {
 			_BitScanForward(&id, EFFECT_KING_G(to));
 			AddPinInfG(NanohaTbl::Direction[id]);
 		}
-	} else if (piece == GOU) {
+	} else if (us == WHITE && piece == GOU) {
 		AddPinInfG(DIR_UP);
 		AddPinInfG(DIR_DOWN);
 		AddPinInfG(DIR_RIGHT);
@@ -1540,9 +1646,9 @@ void Position::undo_move(Move m) {
 	assert(is_ok());
 }
 
+template<Color us>
 void Position::undo_drop(Move m)
 {
-	Color us = side_to_move();
 	Square to = move_to(m);
 	Piece piece = move_piece(m);
 	int kn = 0x80;
@@ -1552,6 +1658,23 @@ void Position::undo_drop(Move m)
 
 	assert(color_of_piece_on(to) == us);
 
+	if (effect_logged()) {
+		// Ֆʂ߂Aƃs͋L^̒l߂
+		kn = komano[to];
+		knkind[kn] = piece;
+		knpos[kn] = (us == BLACK) ? 1 : 2;
+		ban[to] = EMP;
+		komano[to] = 0;
+		xor_piece_bb(piece, to);
+		restore_effect_log();
+		if (us == BLACK) handS.h += Hand::tbl[piece & ~GOTE];
+		else             handG.h += Hand::tbl[piece & ~GOTE];
+
+		st = st->previous;
+		assert(is_ok());
+		return;
+	}
+
 	// ړAړ悪ʂ̉ɂƂɂ̃s폜
 	if (EFFECT_KING_S(to)) {
 		_BitScanForward(&id, EFFECT_KING_S(to));
@@ -1623,6 +1746,7 @@ void Position::undo_drop(Move m)
 	knpos[kn] = (us == BLACK) ? 1 : 2;
 	ban[to] = EMP;
 	komano[to] = 0;
+	xor_piece_bb(piece, to);
 
 	del_effect(to, piece);					// ̗
 
@@ -1663,6 +1787,11 @@ void Position::undo_drop(Move m)
 	assert(is_ok());
 }
 
+template void Position::do_move<BLACK>(Move m, StateInfo& newSt);
+template void Position::do_move<WHITE>(Move m, StateInfo& newSt);
+template void Position::undo_move<BLACK>(Move m);
+template void Position::undo_move<WHITE>(Move m);
+
 // i߂ɃnbVvẐݍs
 uint64_t Position::calc_hash_no_move(const Move m) const
 {
@@ -1677,6 +1806,8 @@ uint64_t Position::calc_hash_no_move(const Move m) const
 	if (!move_is_drop(m)) {
 		// 󔒂ɂȂƂŕςnbVl
 		new_key ^= zobrist[piece][from];
+	} else {
+		new_key ^= zobHand[side_to_move()][piece & ~GOTE][hand[side_to_move()].get(piece & ~GOTE)];
 	}
 
 	// to ̏
@@ -1684,6 +1815,8 @@ uint64_t Position::calc_hash_no_move(const Move m) const
 	Piece capture = move_captured(m);
 	if (capture) {
 		new_key ^= zobrist[ban[to]][to];
+		const int pt = capture & ~(GOTE | PROMOTED);
+		new_key ^= zobHand[side_to_move()][pt][hand[side_to_move()].get(pt) + 1];
 	}
 
 	// Vgɉ
@@ -1907,7 +2040,7 @@ bool Position::pl_move_is_legal(const Move m) const
 		if (ban[to] == WALL) {
 			return false;
 		}
-		if (ban[to] != EMP && color_of(ban[to]) == us) {
+		if (ban[to] != EMP && color_of(Piece(ban[to])) == us) {
 			// ̋Ă
 			return false;
 		}
@@ -2021,7 +2154,7 @@ bool Position::is_pawn_drop_mate(const Color us, int to) const
 				return 0;
 			}
 		}
-#define EscapeG(dir)	piece = ban[kingG + DIR_##dir];	\
+#define EscapeG(dir)	piece = Piece(ban[kingG + DIR_##dir]);	\
 						if (piece != WALL && !(piece & GOTE) && !EXIST_EFFECT(effectB[kingG + DIR_##dir])) return 0
 		EscapeG(UP);
 		EscapeG(UR);
@@ -2078,7 +2211,7 @@ bool Position::is_pawn_drop_mate(const Color us, int to) const
 				return 0;
 			}
 		}
-#define EscapeS(dir)	piece = ban[kingS + DIR_##dir];	\
+#define EscapeS(dir)	piece = Piece(ban[kingS + DIR_##dir]);	\
 						if ((piece == EMP || (piece & GOTE)) && !EXIST_EFFECT(effectW[kingS + DIR_##dir])) return 0
 		EscapeS(DOWN);
 		EscapeS(DR);
@@ -2107,7 +2240,7 @@ MoveStack* Position::add_straight(MoveStack* mlist, const int from, const int di
 		int dan;
 		int fromDan = from & 0x0f;
 		bool promote = can_promotion<us>(fromDan);
-		const Piece piece = ban[from];
+		const Piece piece = Piece(ban[from]);
 		unsigned int tmp = From2Move(from) | Piece2Move(piece);
 		for (to = from + dir; ban[to] == EMP; to += dir) {
 			dan = to & 0x0f;
@@ -2169,7 +2302,7 @@ template<Color us>
 MoveStack* Position::add_move(MoveStack* mlist, const int from, const int dir) const
 {
 	const int to = from + dir;
-	const Piece capture = ban[to];
+	const Piece capture = Piece(ban[to]);
 	if ((capture == EMP) 
 		 || (us == BLACK &&  (capture & GOTE))
 		 || (us == WHITE && ((capture & GOTE) == 0 && capture != WALL))
@@ -2314,35 +2447,22 @@ template <Color us>
 MoveStack* Position::gen_drop(MoveStack* mlist) const
 {
 	int z;
-	int suji;
 	unsigned int tmp;
-	int StartDan;
 ///	int teNum = teNumM;	// AhXȂ
+	// łĂ}X̓rbg{[hŋ߂(rbg̏1؂1iڂ9؂9iڂ̏)
 	// ł
 	uint32_t exists;
 	exists = (us == BLACK) ? handS.existFU() : handG.existFU();
 	if (exists > 0) {
 		tmp  = (us == BLACK) ? Piece2Move(SFU) : Piece2Move(GFU);	// From = 0;
-		//(ȂQiڂ艺ɁAȂWiڂɑłj
-		StartDan = (us == BLACK) ? 2 : 1;
-		for (suji = 0x10; suji <= 0x90; suji += 0x10) {
-			// `FbN
-			if (is_double_pawn(us, suji)) continue;
-			z = suji + StartDan;
+		//(ȂQiڂ艺ɁAȂWiڂɁÂȂ؂ɑłj
+		Bitboard b = drop_squares(us, FU);
+		while (b.any()) {
+			z = b.pop();
 			// łl߂`FbN
-#define FU_FUNC(z)	\
-	if (ban[z] == EMP && !is_pawn_drop_mate(us, z)) {	\
-		(mlist++)->move = Move(tmp | To2Move(z));	\
-	}
-			FU_FUNC(z  )
-			FU_FUNC(z+1)
-			FU_FUNC(z+2)
-			FU_FUNC(z+3)
-			FU_FUNC(z+4)
-			FU_FUNC(z+5)
-			FU_FUNC(z+6)
-			FU_FUNC(z+7)
-#undef FU_FUNC
+			if (!is_pawn_drop_mate(us, z)) {
+				(mlist++)->move = Move(tmp | To2Move(z));
+			}
 		}
 	}
 
@@ -2351,21 +2471,9 @@ MoveStack* Position::gen_drop(MoveStack* mlist) const
 	if (exists > 0) {
 		tmp  = (us == BLACK) ? Piece2Move(SKY) : Piece2Move(GKY); // From = 0
 		//(ȂQiڂ艺ɁAȂWiڂɑłj
-		z = (us == BLACK) ? 0x12 : 0x11;
-		for(; z <= 0x99; z += 0x10) {
-#define KY_FUNC(z)	\
-			if (ban[z] == EMP) {	\
-				(mlist++)->move = Move(tmp | To2Move(z));	\
-			}
-			KY_FUNC(z  )
-			KY_FUNC(z+1)
-			KY_FUNC(z+2)
-			KY_FUNC(z+3)
-			KY_FUNC(z+4)
-			KY_FUNC(z+5)
-			KY_FUNC(z+6)
-			KY_FUNC(z+7)
-#undef KY_FUNC
+		Bitboard b = drop_squares(us, KY);
+		while (b.any()) {
+			(mlist++)->move = Move(tmp | To2Move(b.pop()));
 		}
 	}
 
@@ -2374,26 +2482,16 @@ MoveStack* Position::gen_drop(MoveStack* mlist) const
 	if (exists > 0) {
 		//(ȂRiڂ艺ɁAȂViڂɑłj
 		tmp  = (us == BLACK) ? Piece2Move(SKE) : Piece2Move(GKE); // From = 0
-		z = (us == BLACK) ? 0x13 : 0x11;
-		for ( ; z <= 0x99; z += 0x10) {
-#define KE_FUNC(z)	\
-			if (ban[z] == EMP) {	\
-				(mlist++)->move = Move(tmp | To2Move(z));	\
-			}
-			KE_FUNC(z)
-			KE_FUNC(z+1)
-			KE_FUNC(z+2)
-			KE_FUNC(z+3)
-			KE_FUNC(z+4)
-			KE_FUNC(z+5)
-			KE_FUNC(z+6)
-#undef KE_FUNC
+		Bitboard b = drop_squares(us, KE);
+		while (b.any()) {
+			(mlist++)->move = Move(tmp | To2Move(b.pop()));
 		}
 	}
 
 	// `Ԃ́AǂɂłłĂ
 	const uint32_t koma_start = (us == BLACK) ? SGI : GGI;
 	const uint32_t koma_end = (us == BLACK) ? SHI : GHI;
+	const Bitboard empty = empty_squares();
 	uint32_t a[4];
 	a[0] = (us == BLACK) ? handS.existGI() : handG.existGI();
 	a[1] = (us == BLACK) ? handS.existKI() : handG.existKI();
@@ -2402,21 +2500,9 @@ MoveStack* Position::gen_drop(MoveStack* mlist) const
 	for (uint32_t koma = koma_start, i = 0; koma <= koma_end; koma++, i++) {
 		if (a[i] > 0) {
 			tmp  = Piece2Move(koma); // From = 0
-			for (z = 0x11; z <= 0x99; z += 0x10) {
-#define GI_FUNC(z)	\
-				if (ban[z] == EMP) {	\
-					(mlist++)->move = Move(tmp | To2Move(z));	\
-				}
-				GI_FUNC(z)
-				GI_FUNC(z+1)
-				GI_FUNC(z+2)
-				GI_FUNC(z+3)
-				GI_FUNC(z+4)
-				GI_FUNC(z+5)
-				GI_FUNC(z+6)
-				GI_FUNC(z+7)
-				GI_FUNC(z+8)
-#undef GI_FUNC
+			Bitboard b = empty;
+			while (b.any()) {
+				(mlist++)->move = Move(tmp | To2Move(b.pop()));
 			}
 		}
 	}
@@ -2444,14 +2530,14 @@ MoveStack* Position::gen_move_king(const Color us, MoveStack* mlist, int pindir)
 
 #define MoveKB(dir) to = kingS - DIR_##dir;	\
 					if (EXIST_EFFECT(effectW[to]) == 0) {	\
-						koma = ban[to];		\
+						koma = Piece(ban[to]);		\
 						if (koma == EMP || (koma & GOTE)) {		\
 							(mlist++)->move = Move(tmp | To2Move(to) | Cap2Move(ban[to]));	\
 						}		\
 					}
 #define MoveKW(dir) to = kingG - DIR_##dir;	\
 					if (EXIST_EFFECT(effectB[to]) == 0) {	\
-						koma = ban[to];		\
+						koma = Piece(ban[to]);		\
 						if (koma != WALL && !(koma & GOTE)) {		\
 							(mlist++)->move = Move(tmp | To2Move(to) | Cap2Move(ban[to]));	\
 						}		\
@@ -3127,14 +3213,14 @@ MoveStack* Position::gen_king_noncapture(const Color us, MoveStack* mlist, const
 
 #define MoveKS(dir) to = kingS - DIR_##dir;	\
 					if (EXIST_EFFECT(effectW[to]) == 0) {	\
-						koma = ban[to];		\
+						koma = Piece(ban[to]);		\
 						if (koma == EMP) {		\
 							(mlist++)->move = Move(tmp | To2Move(to) | Cap2Move(ban[to]));	\
 						}		\
 					}
 #define MoveKG(dir) to = kingG - DIR_##dir;	\
 					if (EXIST_EFFECT(effectB[to]) == 0) {	\
-						koma = ban[to];		\
+						koma = Piece(ban[to]);		\
 						if (koma == EMP) {		\
 							(mlist++)->move = Move(tmp | To2Move(to) | Cap2Move(ban[to]));	\
 						}		\
@@ -3362,7 +3448,7 @@ MoveStack* Position::generate_non_evasion(MoveStack* mlist) const
 		for (kn = KNS_HI; kn <= KNE_FU; kn++) {
 			z = knpos[kn];
 			if (OnBoard(z)) {
-				Piece kind = ban[z];
+				Piece kind = Piece(ban[z]);
 				if (!(kind & GOTE)) {
 					mlist = gen_move_from(us, mlist, z);
 				}
@@ -3374,7 +3460,7 @@ MoveStack* Position::generate_non_evasion(MoveStack* mlist) const
 		for (kn = KNS_HI; kn <= KNE_FU; kn++) {
 			z = knpos[kn];
 			if (OnBoard(z)) {
-				Piece kind = ban[z];
+				Piece kind = Piece(ban[z]);
 				if (kind & GOTE) {
 					mlist = gen_move_from(us, mlist, z);
 				}
@@ -3407,29 +3493,25 @@ bool Position::IsKachi(const Color us) const
 	// (e) 錾̋ʂɉ肪ĂȂB(l߂Kł邱Ƃ͊֌WȂ)
 	// (f) 錾̎ԂcĂB(؂ꕉ̏ꍇ)
 
-	int suji;
-	int dan;
-	int maisuu = 0;
-	unsigned int point = 0;
+	// Gw̋ do_move() ōXVĂBقƂǂ̋ǖʂ͏(d)ōς
+	const int maisuu = st->campPieces[us];
+	const int big = st->campBig[us];
+#if !defined(NDEBUG)
+	int bigCheck;
+	assert(maisuu == count_in_enemy_camp(us, bigCheck) && big == bigCheck);
+#endif
+	// (d) 
+	if (maisuu < 10) return false;
+
+	unsigned int point;
 	// (a)
 	if (us == BLACK) {
 		// (b) 
 		if ((kingS & 0x0F) > 3) return false;
 		// (e)
 		if (EXIST_EFFECT(effectW[kingS])) return false;
-		// (c)(d) 
-		for (suji = 0x10; suji <= 0x90; suji += 0x10) {
-			for (dan = 1; dan <= 3; dan++) {
-				Piece piece = Piece(ban[suji+dan] & ~PROMOTED);		// ʂ0ɂȂ̂ŃJEgO
-				if (piece != EMP && !(piece & GOTE)) {
-					if (piece == SHI || piece == SKA) point += 5;
-					else point++;
-					maisuu++;
-				}
-			}
-		}
-		// (d) 
-		if (maisuu < 10) return false;
+		// (c) 
+		point = maisuu + 4 * big;
 		point += handS.getFU() + handS.getKY() + handS.getKE() + handS.getGI() + handS.getKI();
 		point += 5 * handS.getKA();
 		point += 5 * handS.getHI();
@@ -3440,20 +3522,8 @@ bool Position::IsKachi(const Color us) const
 		if ((kingG & 0x0F) < 7) return false;
 		// (e)
 		if (EXIST_EFFECT(effectB[kingG])) return false;
-		// (c)(d) 
-		for (suji = 0x10; suji <= 0x90; suji += 0x10) {
-			for (dan = 7; dan <= 9; dan++) {
-				Piece piece = Piece(ban[suji+dan] & ~PROMOTED);
-				if (piece == (GOU & ~PROMOTED)) continue;
-				if (piece & GOTE) {
-					if (piece == GHI || piece == GKA) point += 5;
-					else point++;
-					maisuu++;
-				}
-			}
-		}
-		// (d) 
-		if (maisuu < 10) return false;
+		// (c) 
+		point = maisuu + 4 * big;
 		point += handG.getFU() + handG.getKY() + handG.getKE() + handG.getGI() + handG.getKI();
 		point += 5 * handG.getKA();
 		point += 5 * handG.getHI();
@@ -3585,6 +3655,37 @@ int set_bit(const int start_bit, const int bits, const int data, unsigned char b
 	}
 	return start_bit + bits;
 }
+
+// p̕\Bstart_bit 8rbg(ʂ)olň
+struct HuffmanDecodeTBL {
+	unsigned char board[256];		// Տ̋
+	unsigned char boardBits[256];	// ̃̕rbg(0:YȂ)
+	unsigned char hand[256];		// 
+	unsigned char handBits[256];
+
+	HuffmanDecodeTBL() {
+		memset(this, 0, sizeof(*this));
+		for (int piece = EMP; piece <= GRY; piece++) {
+			for (int v = 0; v < 256; v++) {
+				if (HB_tbl[piece].bits > 0 && (v & ((1 << HB_tbl[piece].bits) - 1)) == HB_tbl[piece].code) {
+					board[v] = static_cast<unsigned char>(piece);
+					boardBits[v] = static_cast<unsigned char>(HB_tbl[piece].bits);
+				}
+				if (HH_tbl[piece].bits > 0 && (v & ((1 << HH_tbl[piece].bits) - 1)) == HH_tbl[piece].code) {
+					hand[v] = static_cast<unsigned char>(piece);
+					handBits[v] = static_cast<unsigned char>(HH_tbl[piece].bits);
+				}
+			}
+		}
+	}
+};
+
+// buf[]  start_bit 8rbgo(buf[] 2oCg]ɊmۂĂ)
+inline int peek_bits(const unsigned char buf[], const int start_bit)
+{
+	const int n = start_bit / 8;
+	return ((buf[n] | (buf[n+1] << 8)) >> (start_bit % 8)) & 0xFF;
+}
 };
 
 // @\Fǖʂnt}(Ճ[`p)
@@ -3672,6 +3773,83 @@ int Position::EncodeHuffman(unsigned char buf[32]) const
 	return start_bit;
 }
 
+// @\FEncodeHuffman() ŕǖʂ𕜍
+//
+// 
+//   const unsigned char buf[];	// f[^
+//   unsigned char board[9][9];	// Ֆ(init_position() ɓn)
+//   int hand[];				// ̖ [(㍞)]
+//   Color &side;				// 
+//
+// ߂l
+//   }CiXFG[(SĂȂǖʂ͕łȂ)
+//   ̒lFrbg
+//
+int Position::DecodeHuffman(const unsigned char buf[32], unsigned char board[9][9], int hand[GRY+1], Color &side)
+{
+	static const HuffmanDecodeTBL tbl;
+	static const int maxPiece[HI+1] = {0, 18, 4, 4, 4, 4, 2, 2};
+	unsigned char data[32+2] = {0};
+	int count[HI+1] = {0};
+	int start_bit;
+
+	memcpy(data, buf, 32);
+	memset(board, 0, 9*9);
+	memset(hand, 0, sizeof(int)*(GRY+1));
+
+	// ԂƋʂ̈ʒu
+	side = Color(data[0] & 1);
+	const int KingS = (peek_bits(data, 1) & 0x7F);
+	const int KingG = (peek_bits(data, 8) & 0x7F);
+	if (KingS < 1 || KingS > 81 || KingG < 1 || KingG > 81 || KingS == KingG) {
+		return -1;
+	}
+	start_bit = 15;
+
+	// Տ̋
+	int suji, dan;
+	int pieces = 0;
+	for (suji = 0x10; suji <= 0x90; suji += 0x10) {
+		for (dan = 1; dan <= 9; dan++) {
+			const int k = ((suji >> 4) - 1) * 9 + dan;
+			unsigned char piece;
+			if (k == KingS) {
+				piece = SOU;
+			} else if (k == KingG) {
+				piece = GOU;
+			} else {
+				if (start_bit >= 256) return -2;
+				const int v = peek_bits(data, start_bit);
+				if (tbl.boardBits[v] == 0) return -2;
+				piece = tbl.board[v];
+				start_bit += tbl.boardBits[v];
+				if (piece != EMP) {
+					count[piece & ~(GOTE | PROMOTED)]++;
+					pieces++;
+				}
+			}
+			board[dan-1][9 - (suji >> 4)] = piece;
+		}
+	}
+
+	// (c̋ׂĎ)
+	for (; pieces < 38; pieces++) {
+		if (start_bit >= 256) return -3;
+		const int v = peek_bits(data, start_bit);
+		if (tbl.handBits[v] == 0) return -3;
+		hand[tbl.hand[v]]++;
+		count[tbl.hand[v] & ~GOTE]++;
+		start_bit += tbl.handBits[v];
+	}
+	if (start_bit > 256) return -3;
+
+	for (int kind = FU; kind <= HI; kind++) {
+		if (count[kind] != maxPiece[kind]) return -4;
+	}
+
+	return start_bit;
+}
+
 // CX^X.
 template MoveStack* Position::generate_capture<BLACK>(MoveStack* mlist) const;
 template MoveStack* Position::generate_capture<WHITE>(MoveStack* mlist) const;
@@ -20,6 +20,7 @@
 
 #include <iostream>
 
+#include "misc.h"
 #include "thread.h"
 #include "ucioption.h"
 
@@ -50,9 +51,102 @@ namespace { extern "C" {
 
 #endif
 
+#if defined(_MSC_VER) || defined(_WIN32)
+
+	DWORD WINAPI helper_routine(LPVOID helper) {
+
+		((HelperThread*)helper)->fn(((HelperThread*)helper)->arg);
+		return 0;
+	}
+
+#else
+
+	void* helper_routine(void* helper) {
+
+		((HelperThread*)helper)->fn(((HelperThread*)helper)->arg);
+		return NULL;
+	}
+
+#endif
+
 } }
 
 
+/// HelperThread::start() launches fn(arg) on a new thread. If the thread can't
+/// be created fn() is run synchronously, so the work is always done once.
+
+bool HelperThread::start(void (*f)(void*), void* a) {
+
+	fn = f;
+	arg = a;
+#if defined(_MSC_VER) || defined(_WIN32)
+	handle = CreateThread(NULL, 0, helper_routine, (LPVOID)this, 0, NULL);
+	running = (handle != NULL);
+#else
+	running = (pthread_create(&handle, NULL, helper_routine, (void*)this) == 0);
+#endif
+	if (!running)
+		fn(arg);
+
+	return running;
+}
+
+
+/// HelperThread::join() waits for the function started by start() to return
+
+void HelperThread::join() {
+
+	if (!running)
+		return;
+
+#if defined(_MSC_VER) || defined(_WIN32)
+	WaitForSingleObject(handle, INFINITE);
+	CloseHandle(handle);
+#else
+	pthread_join(handle, NULL);
+#endif
+	running = false;
+}
+
+
+/// run_parallel() splits bulk work such as reading the evaluation tables or
+/// clearing the hash over n threads.
+
+namespace {
+
+	struct ParallelTask {
+		void (*fn)(int, void*);
+		void* arg;
+		int idx;
+	};
+
+	void parallel_task(void* task) {
+
+		ParallelTask* t = (ParallelTask*)task;
+		t->fn(t->idx, t->arg);
+	}
+}
+
+void run_parallel(int n, void (*fn)(int, void*), void* arg) {
+
+	HelperThread helpers[MAX_THREADS];
+	ParallelTask tasks[MAX_THREADS];
+
+	n = Max(1, Min(n, MAX_THREADS));
+	for (int i = 1; i < n; i++)
+	{
+		tasks[i].fn = fn;
+		tasks[i].arg = arg;
+		tasks[i].idx = i;
+		helpers[i].start(parallel_task, &tasks[i]);
+	}
+	fn(0, arg);
+
+	for (int i = 1; i < n; i++)
+		helpers[i].join();
+}
+
+
 // wake_up() wakes up the thread, normally at the beginning of the search or,
 // if "sleeping threads" is used, when there is some work to do.
 
@@ -113,6 +207,21 @@ void ThreadsManager::read_uci_options() {
 	useSleepingThreads      = Options["Use Sleeping Threads"].value<bool>();
 
 	set_size(Options["Threads"].value<int>());
+
+#if defined(NANOHA)
+	// With EvalNuma the threads are spread over the NUMA nodes round robin and
+	// each one reads the copy of the evaluation tables on its own node. The
+	// other threads bind themselves when they start searching (idle_loop()).
+	numaNodes = Options["EvalNuma"].value<bool>() ? numa_node_count() : 1;
+	for (int i = 0; i < MAX_THREADS; i++)
+		threads[i].numaNode = (numaNodes > 1 ? i % numaNodes : -1);
+
+	if (threads[0].boundNode != threads[0].numaNode)
+	{
+		numa_bind_self(threads[0].numaNode);
+		threads[0].boundNode = threads[0].numaNode;
+	}
+#endif
 }
 
 
@@ -360,6 +469,9 @@ Value ThreadsManager::split(Position& pos, SearchStack* ss, Value alpha, Value b
 
 	masterThread.splitPoint = sp->parent;
 	pos.set_nodes_searched(pos.nodes_searched() + sp->nodes);
+#if defined(NANOHA)
+	masterThread.searchedNodes -= sp->nodes; // Counted by the threads that searched them
+#endif
 
 	return sp->bestValue;
 }
@@ -33,6 +33,10 @@
 #endif
 #include "position.h"
 
+#if defined(NANOHA)
+struct EvalImage;
+#endif
+
 #if defined(NANOHA)
 const int MAX_THREADS = 16;
 #else
@@ -86,6 +90,21 @@ struct Thread {
 #endif
 	int threadID;
 	int maxPly;
+#if defined(NANOHA)
+	const EvalImage* evalImage; // Tables used by the current search, see eval_search_begin()
+	int numaNode;  // Node the thread runs on and reads its evaluation tables from, -1 if any
+	int boundNode; // Node the thread is currently bound to
+	int64_t searchedNodes;
+	int64_t evalHashProbes;
+	int64_t evalHashHits;
+	int64_t splitCopies;    // Split point positions copied in idle_loop()
+	int64_t splitCopyTicks; // and the cpu ticks spent on the copies
+#if defined(CHK_PERFORM)
+	unsigned long mate1plyDrops; // Mates found by Mate1ply() with a drop
+	unsigned long mate1plyMoves; // Mates found by Mate1ply() with a board move
+	unsigned long mate3plyMates; // Mates found by Mate3()
+#endif
+#endif
 	Lock sleepLock;
 	WaitCondition sleepCond;
 	SplitPoint* volatile splitPoint;
@@ -119,6 +138,9 @@ public:
 	bool use_sleeping_threads() const { return useSleepingThreads; }
 	int min_split_depth() const { return minimumSplitDepth; }
 	int size() const { return activeThreads; }
+#if defined(NANOHA)
+	int numa_nodes() const { return numaNodes; }
+#endif
 
 	void set_size(int cnt);
 	void read_uci_options();
@@ -134,8 +156,34 @@ private:
 	int maxThreadsPerSplitPoint;
 	int activeThreads;
 	bool useSleepingThreads;
+#if defined(NANOHA)
+	int numaNodes;
+#endif
 };
 
 extern ThreadsManager Threads;
 
+
+/// HelperThread runs one function outside of the search threads, e.g. the
+/// initialization work started in the background at launch. run_parallel()
+/// calls fn(idx, arg) for idx = 0..n-1 on n threads (the caller runs idx 0)
+/// and returns when all of them are done.
+
+struct HelperThread {
+
+	bool start(void (*f)(void*), void* a);
+	void join();
+
+	void (*fn)(void*);
+	void* arg;
+	bool running;
+#if defined(_MSC_VER) || defined(_WIN32)
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+};
+
+extern void run_parallel(int n, void (*fn)(int, void*), void* arg);
+
 #endif // !defined(THREAD_H_INCLUDED)
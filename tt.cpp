@@ -21,6 +21,8 @@
 #include <cstring>
 #include <iostream>
 
+#include "misc.h"
+#include "thread.h"
 #include "tt.h"
 
 TranspositionTable TT; // Our global transposition table
@@ -28,12 +30,13 @@ TranspositionTable TT; // Our global transposition table
 TranspositionTable::TranspositionTable() {
 
 	size = generation = 0;
+	mem = NULL;
 	entries = NULL;
 }
 
 TranspositionTable::~TranspositionTable() {
 
-	delete [] entries;
+	delete [] mem;
 }
 
 
@@ -55,14 +58,17 @@ void TranspositionTable::set_size(size_t mbSize) {
 		return;
 
 	size = newSize;
-	delete [] entries;
-	entries = new (std::nothrow) TTCluster[size];
-	if (!entries)
+	delete [] mem;
+
+	// Align the clusters to cache lines, so that a probe touches only one line
+	mem = new (std::nothrow) char[size * sizeof(TTCluster) + 63];
+	if (!mem)
 	{
 		std::cerr << "Failed to allocate " << mbSize
 		          << "MB for transposition table." << std::endl;
 		exit(EXIT_FAILURE);
 	}
+	entries = (TTCluster*)((uintptr_t(mem) + 63) & ~uintptr_t(63));
 	clear();
 }
 
@@ -71,9 +77,32 @@ void TranspositionTable::set_size(size_t mbSize) {
 /// with zeroes. It is called whenever the table is resized, or when the
 /// user asks the program to clear the table (from the UCI interface).
 
+namespace {
+
+	struct ClearTask {
+		char* mem;
+		size_t len;
+		int n;
+	};
+
+	void clear_chunk(int idx, void* arg) {
+
+		const ClearTask* t = (const ClearTask*)arg;
+		const size_t chunk = t->len / t->n;
+		const size_t begin = chunk * idx;
+		memset(t->mem + begin, 0, idx == t->n - 1 ? t->len - begin : chunk);
+	}
+}
+
 void TranspositionTable::clear() {
 
-	memset(entries, 0, size * sizeof(TTCluster));
+	// Large tables are zeroed by all the cores, the pages are also touched here
+	// for the first time after the allocation.
+	ClearTask t = { (char*)entries, size * sizeof(TTCluster), 1 };
+	if (t.len >= (64U << 20))
+		t.n = cpu_count();
+
+	run_parallel(t.n, clear_chunk, &t);
 }
 
 
@@ -85,11 +114,7 @@ void TranspositionTable::clear() {
 /// more valuable than a TTEntry t2 if t1 is from the current search and t2 is from
 /// a previous search, or if the depth of t1 is bigger than the depth of t2.
 
-#if defined(NANOHA)
-void TranspositionTable::store(const Key posKey, uint32_t h, Value v, ValueType t, Depth d, Move m, Value statV, Value kingD) {
-#else
 void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d, Move m, Value statV, Value kingD) {
-#endif
 	int c1, c2, c3;
 	TTEntry *tte, *replace;
 #if defined(NANOHA)
@@ -103,7 +128,7 @@ void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d,
 	for (int i = 0; i < ClusterSize; i++, tte++)
 	{
 #if defined(NANOHA)
-		if (!tte->key() || (tte->key() == posKey48 && tte->hand() == h)) // Empty or overwrite old
+		if (!tte->key() || tte->key() == posKey48) // Empty or overwrite old
 #else
 		if (!tte->key() || tte->key() == posKey32) // Empty or overwrite old
 #endif
@@ -113,7 +138,7 @@ void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d,
 				m = tte->move();
 
 #if defined(NANOHA)
-			tte->save(posKey48, h, v, t, d, m, generation, statV, kingD);
+			tte->save(posKey48, v, t, d, m, generation, statV, kingD);
 #else
 			tte->save(posKey32, v, t, d, m, generation, statV, kingD);
 #endif
@@ -129,7 +154,7 @@ void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d,
 			replace = tte;
 	}
 #if defined(NANOHA)
-	replace->save(posKey48, h, v, t, d, m, generation, statV, kingD);
+	replace->save(posKey48, v, t, d, m, generation, statV, kingD);
 #else
 	replace->save(posKey32, v, t, d, m, generation, statV, kingD);
 #endif
@@ -140,16 +165,15 @@ void TranspositionTable::store(const Key posKey, Value v, ValueType t, Depth d,
 /// transposition table. Returns a pointer to the TTEntry or NULL if
 /// position is not found.
 
+TTEntry* TranspositionTable::probe(const Key posKey) const {
 #if defined(NANOHA)
-TTEntry* TranspositionTable::probe(const Key posKey, uint32_t h) const {
 	uint64_t posKey48 = (posKey & ~UINT64_C(0xFFFF));
 	TTEntry* tte = first_entry(posKey);
 
 	for (int i = 0; i < ClusterSize; i++, tte++)
-		if (tte->key() == posKey48 && tte->hand() == h)
+		if (tte->key() == posKey48)
 			return tte;
 #else
-TTEntry* TranspositionTable::probe(const Key posKey) const {
 	uint32_t posKey32 = posKey >> 32;
 	TTEntry* tte = first_entry(posKey);
 
@@ -170,3 +194,58 @@ TTEntry* TranspositionTable::probe(const Key posKey) const {
 void TranspositionTable::new_search() {
 	generation++;
 }
+
+
+#if defined(NANOHA)
+EvalHashTable EvalHash; // Shared cache of static evaluations
+
+EvalHashTable::EvalHashTable() {
+
+	size = 0;
+	entries = NULL;
+}
+
+EvalHashTable::~EvalHashTable() {
+
+	delete [] entries;
+}
+
+
+/// EvalHashTable::set_size() sets the size of the evaluation cache, measured
+/// in megabytes. Zero disables the cache.
+
+void EvalHashTable::set_size(size_t mbSize) {
+
+	size_t newSize = 0;
+
+	if (mbSize > 0)
+		for (newSize = 1024; 2ULL * newSize * sizeof(EvalHashEntry) <= (mbSize << 20); newSize *= 2) {}
+
+	if (newSize == size)
+		return;
+
+	size = newSize;
+	delete [] entries;
+	entries = NULL;
+	if (!size)
+		return;
+
+	entries = new (std::nothrow) EvalHashEntry[size];
+	if (!entries)
+	{
+		std::cerr << "Failed to allocate " << mbSize
+		          << "MB for evaluation hash table." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	clear();
+}
+
+
+/// EvalHashTable::clear() overwrites the entire cache with zeroes.
+
+void EvalHashTable::clear() {
+
+	if (entries)
+		memset(entries, 0, size * sizeof(EvalHashEntry));
+}
+#endif
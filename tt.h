@@ -48,41 +48,45 @@
 /// Ȃ̂͂ł̕Kvbit
 /// The TTEntry is the class of transposition table entries
 ///
-/// A TTEntry needs 192 bits to be stored
+/// A TTEntry needs 160 bits to be stored
+/// ͋ǖʂ̃nbVL[Ɋ܂܂Ă̂ŕʂɎȂ
+/// key  depth  64bit 1ɂ܂Ƃ߁Akey ̏ƍ 1 64bit rōς܂
 ///
 /// bit   0- 15: depth : 16bits
-/// bit  16- 63: key : 48bits
+/// bit  16- 63: key(48bit) : 48bits
 /// bit  64- 95: move : 32bits
-/// bit  96-125: hand : 30bits
-/// bit 126-127: value type : 2bits
-/// bit 128-143: generation : 16bits
-/// bit 144-159: value : 16bits
-/// bit 160-175: static value : 16bits
-/// bit 176-191: margin of static value : 16bits
+/// bit  96-103: value type : 8bits
+/// bit 104-111: generation : 8bits
+/// bit 112-127: value : 16bits
+/// bit 128-143: static value : 16bits
+/// bit 144-159: margin of static value : 16bits
 
+#if defined(NANOHA)
+// keyDepth  8oCgEɑ 24oCgɂȂ̂ŁA4oCgE 20oCgɋl߂
+#pragma pack(push, 4)
+#endif
 class TTEntry {
 
 public:
 #if defined(NANOHA)
-	void save(uint64_t k, uint32_t h, Value v, ValueType t, Depth d, Move m, int g, Value statV, Value statM) {
+	void save(uint64_t k, Value v, ValueType t, Depth d, Move m, int g, Value statV, Value statM) {
 
-		key_depth    = (k & ~UINT64_C(0xFFFF)) | (d & 0xFFFF);
+		keyDepth     = (k & ~UINT64_C(0xFFFF)) | uint16_t(d);
 		move32       = m;
-		hand30       = (h & 0x3FFFFFFF) | (t << 30);
-		generation16 = uint16_t(g);
+		valueType    = uint8_t(t);
+		generation8  = uint8_t(g);
 		value16      = int16_t(v);
 		staticValue  = int16_t(statV);
 		staticMargin = int16_t(statM);
 	}
-	void set_generation(int g) { generation16 = uint16_t(g); }
+	void set_generation(int g) { generation8 = uint8_t(g); }
 
-	uint64_t key() const              { return (key_depth & ~UINT64_C(0xFFFF)); }
-	uint32_t hand() const             { return (hand30 & 0x3FFFFFFF); }
-	Depth depth() const               { return Depth((int16_t)(key_depth & 0xFFFF)); }
+	uint64_t key() const              { return keyDepth & ~UINT64_C(0xFFFF); }
+	Depth depth() const               { return Depth(int16_t(keyDepth)); }
 	Move move() const                 { return Move(move32); }
 	Value value() const               { return Value(value16); }
-	ValueType type() const            { return ValueType((hand30 >> 30) & 0x0003); }
-	int generation() const            { return int(generation16); }
+	ValueType type() const            { return ValueType(valueType); }
+	int generation() const            { return int(generation8); }
 	Value static_value() const        { return Value(staticValue); }
 	Value static_value_margin() const { return Value(staticMargin); }
 #else
@@ -111,10 +115,9 @@ public:
 
 private:
 #if defined(NANOHA)
-	uint64_t key_depth;
-	uint32_t hand30;
+	uint64_t keyDepth;
 	uint32_t move32;
-	uint16_t generation16;
+	uint8_t valueType, generation8;
 	int16_t value16, staticValue, staticMargin;
 #else
 	uint32_t key32;
@@ -123,11 +126,19 @@ private:
 	int16_t value16, depth16, staticValue, staticMargin;
 #endif
 };
+#if defined(NANOHA)
+#pragma pack(pop)
+#endif
 
 
 /// This is the number of TTEntry slots for each cluster
 // TODO:v:ŎʂɎZoꍇ́Aǖhashvp^[Ȃ̂ŁA4瑝₵قH
+#if defined(NANOHA)
+// 20oCg̃Gg3Ƌlߕ 64oCg(LbVC1{)ɂ
+const int ClusterSize = 3;
+#else
 const int ClusterSize = 4;
+#endif
 
 
 /// TTCluster consists of ClusterSize number of TTEntries. Size of TTCluster
@@ -136,6 +147,9 @@ const int ClusterSize = 4;
 
 struct TTCluster {
 	TTEntry data[ClusterSize];
+#if defined(NANOHA)
+	char padding[64 - ClusterSize * sizeof(TTEntry)];
+#endif
 };
 
 
@@ -152,30 +166,84 @@ public:
 	~TranspositionTable();
 	void set_size(size_t mbSize);
 	void clear();
-#if defined(NANOHA)
-	void store(const Key posKey, uint32_t h, Value v, ValueType type, Depth d, Move m, Value statV, Value kingD);
-	TTEntry* probe(const Key posKey, uint32_t h) const;
-#else
 	void store(const Key posKey, Value v, ValueType type, Depth d, Move m, Value statV, Value kingD);
 	TTEntry* probe(const Key posKey) const;
-#endif
 	void new_search();
 	TTEntry* first_entry(const Key posKey) const;
 	void refresh(const TTEntry* tte) const;
 
 private:
 	size_t size;
-	TTCluster* entries;
-#if defined(NANOHA)
-	uint16_t generation; // Size must be not bigger then TTEntry::generation8
-#else
+	char* mem;
+	TTCluster* entries; // mem aligned to a cache line
 	uint8_t generation; // Size must be not bigger then TTEntry::generation8
-#endif
 };
 
 extern TranspositionTable TT;
 
 
+#if defined(NANOHA)
+/// EvalHashTable ͐ÓI]̕a(StateInfo::evalSum)nbV\B
+/// SXbhŋLAbN͎ȂBcheck  key ^ sum01 ^ sum2 ĂA
+/// ݂Gg͓ǂݏȍƍŒeB
+
+struct EvalHashEntry {
+	uint64_t check;
+	uint64_t sum01;		// evalSum[0] | evalSum[1] << 32
+	uint64_t sum2;		// evalSum[2]
+};
+
+class EvalHashTable {
+
+	EvalHashTable(const EvalHashTable&);
+	EvalHashTable& operator=(const EvalHashTable&);
+
+public:
+	EvalHashTable();
+	~EvalHashTable();
+	void set_size(size_t mbSize);
+	void clear();
+	size_t entry_count() const { return size; }
+	size_t mb_size() const { return (size * sizeof(EvalHashEntry)) >> 20; }
+
+	bool probe(const Key k, int sum[3]) const {
+
+		if (!size)
+			return false;
+
+		const EvalHashEntry* e = entries + (k & (size - 1));
+		const uint64_t s01 = e->sum01, s2 = e->sum2;
+		if ((e->check ^ s01 ^ s2) != k)
+			return false;
+
+		sum[0] = int32_t(uint32_t(s01));
+		sum[1] = int32_t(uint32_t(s01 >> 32));
+		sum[2] = int32_t(uint32_t(s2));
+		return true;
+	}
+
+	void store(const Key k, const int sum[3]) {
+
+		if (!size)
+			return;
+
+		EvalHashEntry* e = entries + (k & (size - 1));
+		const uint64_t s01 = uint64_t(uint32_t(sum[0])) | (uint64_t(uint32_t(sum[1])) << 32);
+		const uint64_t s2 = uint64_t(uint32_t(sum[2]));
+		e->sum01 = s01;
+		e->sum2  = s2;
+		e->check = k ^ s01 ^ s2;
+	}
+
+private:
+	size_t size;
+	EvalHashEntry* entries;
+};
+
+extern EvalHashTable EvalHash;
+#endif
+
+
 /// TranspositionTable::first_entry() returns a pointer to the first entry of
 /// a cluster given a position. The lowest order bits of the key are used to
 /// get the index of the cluster.
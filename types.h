@@ -156,6 +156,42 @@ inline bool cpu_has_popcnt() {
 	return (CPUInfo[2] >> 23) & 1;
 }
 
+/// cpu_has_sse41() and cpu_has_avx2() detect the SIMD extensions used by the
+/// evaluation kernels. AVX2 also needs the OS to save the YMM registers.
+inline bool cpu_has_sse41() {
+
+	int CPUInfo[4] = {-1};
+	__cpuid(CPUInfo, 0x00000001);
+	return (CPUInfo[2] >> 19) & 1;
+}
+
+inline bool cpu_has_avx2() {
+
+	int CPUInfo[4] = {-1};
+	__cpuid(CPUInfo, 0x00000000);
+	if (CPUInfo[0] < 7)
+		return false;
+
+	__cpuid(CPUInfo, 0x00000001);
+	if (!((CPUInfo[2] >> 27) & 1)) // OSXSAVE
+		return false;
+
+#if defined(_MSC_VER) || defined(_WIN32)
+	const unsigned long long xcr0 = _xgetbv(0);
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	unsigned int eax, edx;
+	__asm__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	const unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+#else
+	const unsigned long long xcr0 = 0;
+#endif
+	if ((xcr0 & 6) != 6) // XMM and YMM state
+		return false;
+
+	__cpuid(CPUInfo, 0x00000007);
+	return (CPUInfo[1] >> 5) & 1;
+}
+
 /// CpuHasPOPCNT is a global constant initialized at startup that
 /// is set to true if CPU on which application runs supports popcnt
 /// hardware instruction. Unless USE_POPCNT is not defined.
@@ -388,6 +424,8 @@ inline bool is_drop_knight(const int pos)
 struct Hand {
 	uint32_t h;
 	static const uint32_t tbl[HI+1];
+	static const uint32_t mask[HI+1];
+	static const int shift[HI+1];
 /*
 	xxxxxxxx xxxxxxxx xxxxxxxx xxx11111  
 	xxxxxxxx xxxxxxxx xxxxx111 xxxxxxxx  
@@ -431,6 +469,7 @@ struct Hand {
 	inline uint32_t getKI() const {return ((h & HAND_KI_MASK) >> HAND_KI_SHIFT);}
 	inline uint32_t getKA() const {return ((h & HAND_KA_MASK) >> HAND_KA_SHIFT);}
 	inline uint32_t getHI() const {return ((h & HAND_HI_MASK) >> HAND_HI_SHIFT);}
+	inline int get(const int kind) const {return int((h & mask[kind]) >> shift[kind]);}
 	// Ă邩ǂ(݂mF邾ȂVtgZ͕sv)
 	inline uint32_t existFU() const {return (h & HAND_FU_MASK);}
 	inline uint32_t existKY() const {return (h & HAND_KY_MASK);}
@@ -19,6 +19,7 @@
 */
 
 #include <cassert>
+#include <deque>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -29,6 +30,7 @@
 #include "move.h"
 #include "position.h"
 #include "search.h"
+#include "tt.h"
 #include "ucioption.h"
 
 using namespace std;
@@ -42,10 +44,17 @@ namespace {
 	const char* StarFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 #endif
 
+#if defined(NANOHA)
+	// Keep the states of all the setup moves (from start position to the position
+	// just before to start searching). Sennichite can span the whole game, so draw
+	// detection needs every one of them. A deque never moves its elements.
+	deque<StateInfo> SetupStates;
+#else
 	// Keep track of position keys along the setup moves (from start position to the
 	// position just before to start searching). This is needed by draw detection
 	// where, due to 50 moves rule, we need to check at most 100 plies back.
 	StateInfo StateRingBuf[102], *SetupState = StateRingBuf;
+#endif
 
 	void set_option(istringstream& up);
 	void set_position(Position& pos, istringstream& up);
@@ -75,6 +84,12 @@ void uci_loop() {
 
 		is >> skipws >> token;
 
+#if defined(NANOHA)
+		// NɎn߂ǂݍ݂I܂ŁAǖʂTɊւR}h͑҂
+		if (token != "usi" && token != "setoption" && token != "isready" && token != "quit")
+			wait_application_init();
+#endif
+
 		if (token == "quit")
 			quit = true;
 
@@ -91,7 +106,12 @@ void uci_loop() {
 
 #if defined(NANOHA)
 		else if (token == "isready") {
-			// TODO:{͎Ԃ鏉ōs.
+			// u\̊mۂƃNAAőĂ]xNgEՂ̓ǂݍ݂ƕsčsA
+			// SIĂ readyok Ԃ
+			TT.set_size(Options["Hash"].value<int>());
+			EvalHash.set_size(Options["EvalHash"].value<int>());
+			wait_application_init();
+			poll_eval_reload(true);
 			cout << "readyok" << endl;
 		}
 #else
@@ -102,6 +122,18 @@ void uci_loop() {
 		else if (token == "position")
 			set_position(pos, is);
 
+#if defined(NANOHA)
+		// evalreload [t@C]: ]xNgǂݒ(ȗ EvalFile IvV̂)
+		else if (token == "evalreload")
+		{
+			string name;
+			if (is >> name)
+				Options["EvalFile"].set_value(name);
+			poll_eval_reload(true);
+			start_eval_reload(Options["EvalFile"].value<string>(), true);
+		}
+#endif
+
 		else if (token == "setoption")
 			set_option(is);
 
@@ -196,6 +228,14 @@ namespace {
 #endif
 
 		// Parse move list (if any)
+#if defined(NANOHA)
+		SetupStates.clear();
+		while (is >> token && (m = move_from_uci(pos, token)) != MOVE_NONE)
+		{
+			SetupStates.push_back(StateInfo());
+			pos.do_move(m, SetupStates.back());
+		}
+#else
 		while (is >> token && (m = move_from_uci(pos, token)) != MOVE_NONE)
 		{
 			pos.do_move(m, *SetupState);
@@ -204,6 +244,7 @@ namespace {
 			if (++SetupState - StateRingBuf >= 102)
 				SetupState = StateRingBuf;
 		}
+#endif
 	}
 
 
@@ -229,6 +270,16 @@ namespace {
 			Options[name].set_value(value.empty() ? "true" : value); // UCI buttons don't have "value"
 		else
 			cout << "No such option: " << name << endl;
+
+#if defined(NANOHA)
+		// ]xNg͗œǂݍ݁AǂݏIƂōւ
+		if (name == "EvalFile")
+		{
+			wait_application_init();
+			poll_eval_reload(true);
+			start_eval_reload(Options["EvalFile"].value<string>(), false);
+		}
+#endif
 	}
 
 
@@ -84,6 +84,11 @@ OptionsMap::OptionsMap() {
 #endif
 	o["Threads"] = UCIOption(1, 1, MAX_THREADS);
 	o["Hash"] = UCIOption(256, 4, 32768);
+#if defined(NANOHA)
+	o["EvalHash"] = UCIOption(16, 0, 1024);
+	o["EvalFile"] = UCIOption("fv3map.bin");
+	o["EvalNuma"] = UCIOption(false);
+#endif
 
 	o["Use Search Log"] = UCIOption(false);
 	o["Search Log Filename"] = UCIOption("SearchLog.txt");